@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+#include "asyncwriter.h"
+
+AsyncWriter::AsyncWriter(const std::string &path_, std::size_t bufferSize_, int numBuffers)
+        : path(path_), bufferSize(std::max<std::size_t>(bufferSize_, 64)) {
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("can't open " + path);
+    }
+    current.reserve(bufferSize);
+    // one being filled, one being written, the rest in either queue
+    for (int b = 1; b < std::max(2, numBuffers); ++b) {
+        empty.emplace_back();
+        empty.back().reserve(bufferSize);
+    }
+    writer = std::thread(&AsyncWriter::writerLoop, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+    try {
+        close();
+    } catch (const std::runtime_error &) {
+    }
+}
+
+void AsyncWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [&]() { return !full.empty() || closing; });
+        if (full.empty()) {
+            return; // closing and nothing left
+        }
+        std::vector<char> buffer = std::move(full.front());
+        full.pop_front();
+        lock.unlock();
+        bool ok = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        buffer.clear();
+        lock.lock();
+        failed = failed || !ok;
+        empty.push_back(std::move(buffer));
+        changed.notify_all();
+    }
+}
+
+void AsyncWriter::handOff() {
+    if (current.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    full.push_back(std::move(current));
+    changed.notify_all();
+    changed.wait(lock, [&]() { return !empty.empty(); });
+    current = std::move(empty.front());
+    empty.pop_front();
+}
+
+char *AsyncWriter::reserve(std::size_t length) {
+    if (current.size() + length > bufferSize) {
+        handOff();
+    }
+    std::size_t used = current.size();
+    current.resize(used + length);
+    return current.data() + used;
+}
+
+void AsyncWriter::write(const char *text, std::size_t length) {
+    while (length > 0) {
+        if (current.size() == bufferSize) {
+            handOff();
+        }
+        std::size_t chunk = std::min(length, bufferSize - current.size());
+        current.insert(current.end(), text, text + chunk);
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+void AsyncWriter::number(double value) {
+    // 24 characters fit any double
+    char *start = reserve(24);
+    char *end = std::to_chars(start, start + 24, value).ptr;
+    current.resize(end - current.data());
+}
+
+void AsyncWriter::number(long value) {
+    char *start = reserve(20);
+    char *end = std::to_chars(start, start + 20, value).ptr;
+    current.resize(end - current.data());
+}
+
+void AsyncWriter::row(const double *values, std::size_t count, char sep) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            put(sep);
+        }
+        number(values[i]);
+    }
+    put('\n');
+}
+
+void AsyncWriter::close() {
+    if (file == nullptr) {
+        return;
+    }
+    handOff();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    changed.notify_all();
+    writer.join();
+    bool closedOk = std::fclose(file) == 0;
+    file = nullptr;
+    if (failed || !closedOk) {
+        throw std::runtime_error("failed writing " + path);
+    }
+}
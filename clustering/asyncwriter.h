@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * buffered file output with the actual writing on its own thread, so formatting the next buffer overlaps with the
+ * disk taking the last one. text goes into a big buffer, and a full buffer is handed to the writer thread and
+ * swapped for an empty one. the buffers get reused, and there are never more than numBuffers of them, so memory
+ * stays bounded however much gets written (the caller waits for a free buffer if the disk falls behind).
+ * numbers are formatted with std::to_chars, the shortest text that reads back as exactly the same double.
+ * one thread at a time writes to it
+ */
+class AsyncWriter {
+public:
+    // throws std::runtime_error if path can't be opened
+    explicit AsyncWriter(const std::string &path, std::size_t bufferSize_ = 1 << 20, int numBuffers = 4);
+    ~AsyncWriter(); // closes it, errors are lost. call close() to hear about them
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    void write(const char *text, std::size_t length);
+    void write(const std::string &text) { write(text.data(), text.size()); }
+    void put(char c) {
+        if (current.size() == bufferSize) {
+            handOff();
+        }
+        current.push_back(c);
+    }
+    void number(double value);
+    void number(long value);
+    // the values separated by sep, then a newline
+    void row(const double *values, std::size_t count, char sep = ',');
+
+    // writes whatever's left and waits for the writer thread. throws std::runtime_error if any write failed
+    void close();
+
+private:
+    void handOff(); // current goes to the writer thread, and an empty buffer takes its place
+    void writerLoop();
+    char *reserve(std::size_t length); // room for length more chars at the end of current
+
+    std::string path;
+    std::size_t bufferSize;
+    std::FILE *file = nullptr;
+    std::vector<char> current;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<char>> full, empty; // waiting to be written, and ready to be reused
+    bool closing = false, failed = false;
+    std::thread writer;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include "dataset.h"
+
+/*
+ * hands out a dataset a batch at a time, for data that doesn't fit in memory. csv::Reader is one.
+ * batch is reused between calls, so after the first batch reading allocates nothing
+ */
+class BatchReader {
+public:
+    virtual ~BatchReader() = default;
+    // replaces batch with up to maxRows of the next points. returns false (and an empty batch) when there are none left
+    virtual bool next(Dataset &batch, std::size_t maxRows) = 0;
+    virtual void rewind() = 0; // start over from the first point
+    virtual std::size_t dim() const = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "benchreport.h"
+
+/*
+ * each bench_*.cpp has one function that runs its benchmark on sizes up to maxN, and benchmarks.cpp picks which ones
+ * to run from the command line. they report through benchreport.h, shared with neuralNets
+ */
+namespace bench {
+    void spatialIndex(long maxN);
+    void csvParse(long maxN);
+    void typedCSV(long maxN);
+    void kmeans(long maxN);
+    void kmeansThreads(long maxN);
+    void kmeansSeeding(long maxN);
+    void miniBatchKMeans(long maxN);
+    void kmeansModel(long maxN);
+    void dbscan(long maxN);
+    void metrics(long maxN);
+    void generator(long maxN);
+    void output(long maxN);
+}
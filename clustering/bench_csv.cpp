@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "columnar.h"
+#include "csv.h"
+#include "datagen.h"
+
+/*
+ * saveCSV, then csv::parse against csv::parseMapped with one thread and with every core on what it wrote, and
+ * loading the same data back from a columnar file. also checks that they all read back exactly the same values
+ */
+void bench::csvParse(long maxN) {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (long n = 1000; n <= maxN; n *= 10) {
+        std::string name = tempPath("bench_csv_" + std::to_string(n));
+        Dataset generated = dataGen::generateClusters(1000, 1000, 0, 0, n / 10, 10, 0, 100, 320);
+        Clock::time_point start = Clock::now();
+        dataGen::saveCSV(generated, name);
+        std::string fileName = name + ".csv";
+        long bytes = std::filesystem::file_size(fileName);
+        report("dataGen::saveCSV", generated.size(), secondsSince(start), bytes);
+
+        start = Clock::now();
+        Dataset slow = csv::parse(fileName, ',');
+        report("csv::parse", slow.size(), secondsSince(start), bytes);
+
+        start = Clock::now();
+        Dataset single = csv::parseMapped(fileName, ',', 1);
+        report("csv::parseMapped 1 thread", single.size(), secondsSince(start), bytes);
+
+        start = Clock::now();
+        Dataset parallel = csv::parseMapped(fileName, ',', cores);
+        report("csv::parseMapped " + std::to_string(cores) + " threads", parallel.size(), secondsSince(start), bytes);
+
+        std::string cacheName = name + ".col";
+        start = Clock::now();
+        columnar::save(parallel, cacheName);
+        report("columnar::save", parallel.size(), secondsSince(start), std::filesystem::file_size(cacheName));
+        start = Clock::now();
+        Dataset cached = columnar::load(cacheName);
+        report("columnar::load", cached.size(), secondsSince(start), std::filesystem::file_size(cacheName));
+
+        bool same = slow.size() == single.size() && slow.size() == parallel.size() && slow.size() == cached.size() &&
+                    slow.dim() == single.dim() && slow.dim() == parallel.dim() && slow.dim() == cached.dim();
+        for (std::size_t i = 0; same && i < slow.size() * slow.dim(); ++i) {
+            same = slow.data()[i] == single.data()[i] && slow.data()[i] == parallel.data()[i] &&
+                   slow.data()[i] == cached.data()[i];
+        }
+        if (!same) {
+            bench::mismatch() << "parsers disagree on " << fileName << std::endl;
+        }
+        std::remove(fileName.c_str());
+        std::remove(cacheName.c_str());
+    }
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "datagen.h"
+#include "dbscan.h"
+#include "neighborgraph.h"
+
+/*
+ * parallel DBscan::labels at 1, 2, 4, ... threads vs the serial breadth first version, on clustered data that keeps
+ * the same density as it grows (like bench_spatial). every run's labels have to match the serial ones exactly.
+ * then a parameter sweep, once searching from scratch for every (maxDist, minPts) and once over a NeighborGraph built
+ * for the biggest maxDist, which has to give the same labels
+ */
+void bench::dbscan(long maxN) {
+    const double maxDist = 10;
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (long n = 10000; n <= maxN; n *= 10) {
+        int side = 10 * std::sqrt(n);
+        int numClusters = 10;
+        int numNoise = n / 10;
+        Dataset data = dataGen::generateClusters(
+                side, side, 0, 0, (n - numNoise) / numClusters, numClusters, numNoise, side / 20.0);
+
+        DBscan scanner(maxDist, 5);
+        Clock::time_point start = Clock::now();
+        std::vector<int> expected = scanner.serialLabels(data);
+        report("DBscan::serialLabels", data.size(), secondsSince(start));
+        int found = *std::max_element(expected.begin(), expected.end()) + 1;
+        long noise = std::count(expected.begin(), expected.end(), DBscan::noiseLabel);
+        std::cout << "    " << found << " clusters, " << noise << " noise points" << std::endl;
+
+        double oneThread = 0;
+        for (int threads = 1; threads <= std::max(cores, 2); threads *= 2) {
+            scanner.numThreads = threads;
+            start = Clock::now();
+            std::vector<int> labels = scanner.labels(data);
+            double seconds = secondsSince(start);
+            report("DBscan::labels " + std::to_string(threads) + " threads", data.size(), seconds);
+            if (threads == 1) {
+                oneThread = seconds;
+            }
+            std::cout << "    efficiency=" << oneThread / seconds / threads << std::endl;
+            if (labels != expected) {
+                bench::mismatch() << threads << " thread labels differ from serialLabels" << std::endl;
+            }
+        }
+
+        const double dists[] = {4, 6, 8, 10};
+        const int minPtss[] = {3, 5, 10};
+        scanner.numThreads = 0;
+        start = Clock::now();
+        std::vector<std::vector<int>> scratch;
+        for (double d : dists) {
+            for (int minPts : minPtss) {
+                scratch.push_back(DBscan(d, minPts).labels(data));
+            }
+        }
+        report("sweep, labels from scratch", data.size(), secondsSince(start));
+
+        start = Clock::now();
+        spatial::NeighborGraph graph(data, dists[3]);
+        double built = secondsSince(start);
+        int run = 0;
+        for (double d : dists) {
+            for (int minPts : minPtss) {
+                if (DBscan(d, minPts).labels(graph) != scratch[run++]) {
+                    bench::mismatch() << "NeighborGraph labels differ at maxDist=" << d << " minPts=" << minPts
+                              << std::endl;
+                }
+            }
+        }
+        report("sweep, over a NeighborGraph", data.size(), secondsSince(start));
+        std::cout << "    graph build=" << built << "s, " << graph.numEdges() << " edges, "
+                  << graph.bytes() / (1024 * 1024) << "MiB" << std::endl;
+    }
+}
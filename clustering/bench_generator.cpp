@@ -0,0 +1,54 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "columnar.h"
+#include "csv.h"
+#include "generator.h"
+
+namespace {
+    bool same(DatasetView a, DatasetView b) {
+        return a.size() == b.size() && a.dim() == b.dim() &&
+               std::memcmp(a.data(), b.data(), a.size() * a.dim() * sizeof(double)) == 0;
+    }
+}
+
+/*
+ * dataGen::Generator on 1 thread and on every core, and writing straight to csv and columnar files. the points
+ * have to be the same whatever the thread count, a range made on its own has to match the same points made with
+ * everything else, and both files have to read back exactly what was generated
+ */
+void bench::generator(long maxN) {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (long n = 10000; n <= maxN; n *= 10) {
+        dataGen::Generator gen(4, 20, 320);
+        gen.noise = 0.05;
+        Clock::time_point start = Clock::now();
+        Dataset single = gen.generate(n, 1);
+        report("Generator::generate 1 thread", n, secondsSince(start));
+        start = Clock::now();
+        Dataset parallel = gen.generate(n, cores);
+        report("Generator::generate " + std::to_string(cores) + " threads", n, secondsSince(start));
+        if (!same(single, parallel) || !same(gen.range(n / 3, n / 2), parallel.view().slice(n / 3, n / 2))) {
+            bench::mismatch() << "generated points depend on how they were split up" << std::endl;
+        }
+
+        std::string csvName = tempPath("bench_generator.csv"), columnarName = tempPath("bench_generator.col");
+        start = Clock::now();
+        gen.writeCSV(csvName, n);
+        report("Generator::writeCSV", n, secondsSince(start), std::filesystem::file_size(csvName));
+        start = Clock::now();
+        gen.writeColumnar(columnarName, n);
+        report("Generator::writeColumnar", n, secondsSince(start), std::filesystem::file_size(columnarName));
+        if (!same(csv::parseMapped(csvName, ','), single)) {
+            bench::mismatch() << "csv doesn't read back what was generated" << std::endl;
+        }
+        if (!same(columnar::load(columnarName), single)) {
+            bench::mismatch() << "columnar file doesn't read back what was generated" << std::endl;
+        }
+        std::remove(csvName.c_str());
+        std::remove(columnarName.c_str());
+    }
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "bench.h"
+#include "datagen.h"
+#include "kmeans.h"
+#include "simd.h"
+
+namespace {
+    // k random data points, the same ones every time so every algorithm starts from the same place
+    Dataset pickCentroids(DatasetView data, int k) {
+        std::mt19937 gen(320);
+        std::uniform_int_distribution<std::size_t> dis(0, data.size() - 1);
+        Dataset centroids(0, data.dim());
+        for (int i = 0; i < k; ++i) {
+            centroids.push(data[dis(gen)]);
+        }
+        return centroids;
+    }
+}
+
+/*
+ * Lloyd vs Elkan vs Hamerly from the same starting centroids. reports the time and how many distances each one
+ * computed, and checks the bound based ones end up with exactly the same labels as Lloyd. then cluster(), which is
+ * fit plus copying every point into its cluster's Dataset, checked against fit's labels
+ */
+void bench::kmeans(long maxN) {
+    for (int k : {10, 100}) {
+        for (long n = 1000; n <= maxN; n *= 10) {
+            Dataset data = dataGen::generateClusters(10000, 10000, 0, 0, n / k, k, 0, 300);
+            KMeansResult baseline;
+            for (KMeans::Algorithm algorithm : {KMeans::Algorithm::Lloyd, KMeans::Algorithm::Elkan,
+                                                KMeans::Algorithm::Hamerly}) {
+                KMeans clusterer(k, 0.01, algorithm);
+                clusterer.verbose = false;
+                Clock::time_point start = Clock::now();
+                KMeansResult result = clusterer.fit(data, pickCentroids(data, k));
+                double seconds = secondsSince(start);
+
+                const char *name = algorithm == KMeans::Algorithm::Lloyd ? "lloyd" :
+                                   algorithm == KMeans::Algorithm::Elkan ? "elkan" : "hamerly";
+                report(std::string("kmeans ") + name + " k=" + std::to_string(k), data.size(), seconds);
+                std::cout << "    iterations=" << result.iterations << " distances=" << result.distanceEvals
+                          << " inertia=" << result.inertia << std::endl;
+                if (algorithm == KMeans::Algorithm::Lloyd) {
+                    baseline = std::move(result);
+                } else if (result.labels != baseline.labels) {
+                    bench::mismatch() << name << " labels differ from lloyd" << std::endl;
+                }
+            }
+
+            KMeans clusterer(k, 0.01, KMeans::Algorithm::Hamerly);
+            clusterer.verbose = false;
+            Clock::time_point start = Clock::now();
+            std::vector<Dataset> clusters = clusterer.cluster(data);
+            report("kmeans cluster hamerly k=" + std::to_string(k), data.size(), secondsSince(start));
+            std::vector<int> labels = clusterer.fit(data).labels;
+            for (int c = 0; c < k; ++c) {
+                if (clusters[c].size() != (std::size_t) std::count(labels.begin(), labels.end(), c)) {
+                    bench::mismatch() << "cluster " << c << " of k=" << k << " has " << clusters[c].size()
+                                      << " points, fit labelled " << std::count(labels.begin(), labels.end(), c)
+                                      << std::endl;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Lloyd's assignment step at every thread count from 1 to the number of cores (doubling), and with each simd
+ * kernel on one thread. runs a fixed number of iterations so the throughput is points * iterations / second
+ */
+void bench::kmeansThreads(long maxN) {
+    const int k = 64, iterations = 10;
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    Dataset data = dataGen::generateClusters(10000, 10000, 0, 0, maxN / k, k, 0, 300);
+    Dataset start = pickCentroids(data, k);
+
+    auto run = [&](int threads) {
+        KMeans clusterer(k, 0, KMeans::Algorithm::Lloyd);
+        clusterer.verbose = false;
+        clusterer.maxIterations = iterations;
+        clusterer.numThreads = threads;
+        Clock::time_point begin = Clock::now();
+        KMeansResult result = clusterer.fit(data, start.clone());
+        return std::make_pair(secondsSince(begin), std::move(result));
+    };
+
+    for (simd::Kernel kernel : {simd::Kernel::Scalar, simd::Kernel::AVX2, simd::Kernel::AVX512}) {
+        simd::useKernel(kernel);
+        double seconds = run(1).first;
+        report(std::string("kmeans lloyd 1 thread ") + simd::kernelName(), data.size() * iterations, seconds);
+    }
+    simd::useKernel(simd::Kernel::Auto);
+
+    std::vector<int> serialLabels = run(1).second.labels;
+    for (int threads = 1; threads <= std::max(cores, 2); threads *= 2) {
+        std::pair<double, KMeansResult> timed = run(threads);
+        report("kmeans lloyd " + std::to_string(threads) + " threads " + simd::kernelName(),
+               data.size() * iterations, timed.first);
+        std::cout << "    per thread: " << (long) (data.size() * iterations / timed.first / threads) << "/s"
+                  << std::endl;
+        // summing in a different order can move a centroid by a rounding error, so count instead of requiring equal
+        long differ = 0;
+        for (std::size_t i = 0; i < serialLabels.size(); ++i) {
+            differ += serialLabels[i] != timed.second.labels[i];
+        }
+        if (differ > 0) {
+            std::cout << "    " << differ << " labels differ from 1 thread" << std::endl;
+        }
+    }
+}
+
+/*
+ * starting centroids: random box vs k-means++ vs k-means||, then the multi restart search over k.
+ * the search runs twice with different thread counts to check the seeds make it reproducible
+ */
+void bench::kmeansSeeding(long maxN) {
+    const int k = 8;
+    Dataset data = dataGen::generateClusters(10000, 10000, 0, 0, maxN / k, k, 0, 300);
+    for (KMeans::Init init : {KMeans::Init::RandomBox, KMeans::Init::KMeansPlusPlus, KMeans::Init::KMeansParallel}) {
+        KMeans clusterer(k, 0.01, KMeans::Algorithm::Hamerly);
+        clusterer.init = init;
+        clusterer.verbose = false;
+        clusterer.numThreads = 0;
+        Clock::time_point start = Clock::now();
+        KMeansResult result = clusterer.fit(data);
+        const char *name = init == KMeans::Init::RandomBox ? "random box" :
+                           init == KMeans::Init::KMeansPlusPlus ? "k-means++" : "k-means||";
+        report(std::string("kmeans seeded with ") + name, data.size(), secondsSince(start));
+        std::vector<long> sizes(k, 0);
+        for (int label : result.labels) {
+            ++sizes[label];
+        }
+        std::cout << "    iterations=" << result.iterations << " inertia=" << result.inertia
+                  << " empty clusters=" << std::count(sizes.begin(), sizes.end(), 0) << std::endl;
+    }
+
+    KMeansSearch search(2, 12, 4);
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<double> firstInertias;
+    for (int threads : {1, std::max(cores, 2)}) {
+        search.numThreads = threads;
+        Clock::time_point start = Clock::now();
+        std::vector<KMeansResult> best = search.run(data);
+        report("kmeans search k=2..12 x4 restarts, " + std::to_string(threads) + " threads", data.size(),
+               secondsSince(start));
+        std::cout << "    picked k=" << search.pickK(best) << " (data has " << k << ")" << std::endl;
+        std::vector<double> inertias;
+        for (const KMeansResult &result : best) {
+            inertias.push_back(result.inertia);
+        }
+        if (firstInertias.empty()) {
+            firstInertias = inertias;
+        } else if (inertias != firstInertias) {
+            bench::mismatch() << "search results depend on the thread count" << std::endl;
+        }
+    }
+}
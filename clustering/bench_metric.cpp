@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cmath>
+#include <string>
+#include "bench.h"
+#include "datagen.h"
+#include "dbscan.h"
+#include "kmeans.h"
+#include "metric.h"
+
+namespace {
+    // sum of the distances between neighboring points, with the loop over the dimensions unrolled (D) or not
+    template <typename Metric, std::size_t D>
+    double chain(DatasetView data) {
+        double sum = 0;
+        for (std::size_t i = 1; i < data.size(); ++i) {
+            sum += Metric::template distance<D>(data[i - 1].data(), data[i].data(), data.dim());
+        }
+        return sum;
+    }
+
+    template <typename Metric>
+    void timeDistances(const std::string &name, DatasetView data) {
+        const int repeats = 100;
+        double fixed = 0, dynamic = 0;
+        bench::Clock::time_point start = bench::Clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            fixed += chain<Metric, 2>(data);
+        }
+        bench::report(name + " fixed 2d", data.size() * repeats, bench::secondsSince(start));
+        start = bench::Clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            dynamic += chain<Metric, metric::dynamic>(data);
+        }
+        bench::report(name + " dynamic", data.size() * repeats, bench::secondsSince(start));
+        if (fixed != dynamic) {
+            bench::mismatch() << name << " fixed and dynamic dimensions give different distances" << std::endl;
+        }
+    }
+
+    template <typename Metric>
+    KMeansResult runKMeans(const std::string &name, DatasetView data, KMeans::Algorithm algorithm,
+                           double threshold = 0.01) {
+        KMeans clusterer(10, threshold, algorithm);
+        clusterer.verbose = false;
+        bench::Clock::time_point start = bench::Clock::now();
+        KMeansResult result = clusterer.fit<Metric>(data);
+        bench::report("kmeans " + name, data.size(), bench::secondsSince(start));
+        std::cout << "    iterations=" << result.iterations << " inertia=" << result.inertia << std::endl;
+        return result;
+    }
+
+    template <typename Metric>
+    std::vector<int> runDBscan(const std::string &name, DatasetView data, double maxDist,
+                               spatial::IndexType indexType = spatial::IndexType::Grid) {
+        DBscan scanner(maxDist, 5, indexType);
+        bench::Clock::time_point start = bench::Clock::now();
+        std::vector<int> labels = scanner.labels<Metric>(data);
+        bench::report("dbscan " + name, data.size(), bench::secondsSince(start));
+        return labels;
+    }
+}
+
+/*
+ * the metric.h distances with the number of dimensions fixed at compile time vs not, then KMeans and DBscan with
+ * each metric. squared euclidean and euclidean have to give the same clusters, manhattan the same ones whichever
+ * way the candidates are found, and the bound based KMeans the same ones as Lloyd
+ */
+void bench::metrics(long maxN) {
+    for (long n = 10000; n <= maxN; n *= 10) {
+        int side = 10 * std::sqrt(n);
+        Dataset data = dataGen::generateClusters(side, side, 0, 0, n / 10, 10, 0, side / 20.0);
+        timeDistances<metric::SquaredEuclidean>("squared euclidean", data);
+        timeDistances<metric::Euclidean>("euclidean", data);
+        timeDistances<metric::Manhattan>("manhattan", data);
+        timeDistances<metric::Cosine>("cosine", data);
+
+        KMeansResult squared = runKMeans<metric::SquaredEuclidean>("squared euclidean", data, KMeans::Algorithm::Lloyd);
+        if (runKMeans<metric::Euclidean>("euclidean", data, KMeans::Algorithm::Lloyd).labels != squared.labels) {
+            bench::mismatch() << "euclidean kmeans labels differ from squared euclidean" << std::endl;
+        }
+        KMeansResult medians = runKMeans<metric::Manhattan>("manhattan lloyd", data, KMeans::Algorithm::Lloyd);
+        if (runKMeans<metric::Manhattan>("manhattan hamerly", data, KMeans::Algorithm::Hamerly).labels !=
+            medians.labels) {
+            bench::mismatch() << "manhattan hamerly labels differ from lloyd" << std::endl;
+        }
+        runKMeans<metric::Cosine>("cosine", data, KMeans::Algorithm::Lloyd, 1e-9); // angles barely move
+
+        const double maxDist = 10;
+        if (runDBscan<metric::SquaredEuclidean>("squared euclidean", data, maxDist * maxDist) !=
+            runDBscan<metric::Euclidean>("euclidean", data, maxDist)) {
+            bench::mismatch() << "squared euclidean dbscan labels differ from euclidean" << std::endl;
+        }
+        std::vector<int> manhattan = runDBscan<metric::Manhattan>("manhattan grid", data, maxDist);
+        if (n <= 10000) {
+            // every pair, so only on the small one
+            if (runDBscan<metric::Manhattan>("manhattan brute force", data, maxDist, spatial::IndexType::BruteForce) !=
+                manhattan) {
+                bench::mismatch() << "manhattan dbscan labels depend on the index" << std::endl;
+            }
+            runDBscan<metric::Cosine>("cosine", data, 0.001);
+        }
+    }
+}
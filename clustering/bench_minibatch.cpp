@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "csv.h"
+#include "kmeans.h"
+
+namespace {
+    // writes n clustered 2d points without ever holding them all, so the input can be bigger than memory
+    void writeClusteredCSV(const std::string &fileName, long n, int k) {
+        std::ofstream out(fileName);
+        std::mt19937 gen(n);
+        std::uniform_real_distribution<double> center(0, 10000), offset(-300, 300);
+        std::vector<double> centers(2 * k);
+        for (double &c : centers) {
+            c = center(gen);
+        }
+        std::string line;
+        for (long i = 0; i < n; ++i) {
+            int c = i % k;
+            line = std::to_string(centers[2 * c] + offset(gen)) + "," + std::to_string(centers[2 * c + 1] + offset(gen));
+            out << line << "\n";
+        }
+    }
+}
+
+/*
+ * streaming mini-batch k-means over csv files of growing size. each run happens in a forked child so its peak
+ * resident memory can be measured on its own, which should stay flat as the file grows: the biggest file's peak
+ * can't be more than maxGrowthMB over the smallest's, or something is holding on to the input
+ */
+void bench::miniBatchKMeans(long maxN) {
+    const int k = 16;
+    const long maxGrowthMB = 32;
+    long firstPeakKB = -1, lastPeakKB = -1, lastBytes = 0;
+    for (long n = 100000; n <= maxN * 10; n *= 10) {
+        std::string fileName = tempPath("bench_minibatch_" + std::to_string(n) + ".csv");
+        std::string labelFile = tempPath("bench_minibatch_labels.txt");
+        writeClusteredCSV(fileName, n, k);
+        long bytes = std::filesystem::file_size(fileName);
+
+        Clock::time_point start = Clock::now();
+        pid_t child = fork();
+        if (child == 0) {
+            csv::Reader reader(fileName, ',');
+            MiniBatchKMeans clusterer(k);
+            Dataset centroids = clusterer.fit(reader);
+            clusterer.assign(reader, centroids, labelFile);
+            _exit(0);
+        }
+        int status;
+        struct rusage usage;
+        wait4(child, &status, 0, &usage);
+        report("minibatch kmeans fit + assign", n, secondsSince(start), bytes);
+        // ru_maxrss is kilobytes on linux and bytes on mac
+#ifdef __APPLE__
+        long peakKB = usage.ru_maxrss / 1024;
+#else
+        long peakKB = usage.ru_maxrss;
+#endif
+        std::cout << "    input " << bytes / (1 << 20) << "MB, peak rss " << peakKB / 1024 << "MB" << std::endl;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            bench::mismatch() << "minibatch child failed on n=" << n << std::endl;
+        }
+        firstPeakKB = firstPeakKB < 0 ? peakKB : firstPeakKB;
+        lastPeakKB = peakKB;
+        lastBytes = bytes;
+        std::remove(fileName.c_str());
+        std::remove(labelFile.c_str());
+    }
+    if (lastPeakKB - firstPeakKB > maxGrowthMB * 1024) {
+        bench::mismatch() << "peak rss grew from " << firstPeakKB / 1024 << "MB to " << lastPeakKB / 1024
+                          << "MB with a " << lastBytes / (1 << 20) << "MB input" << std::endl;
+    }
+}
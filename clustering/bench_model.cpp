@@ -0,0 +1,97 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "generator.h"
+#include "kmeans.h"
+
+/*
+ * KMeansModel: labelling new points with every centroid checked (simd) vs the KDTree over the centroids, for a few
+ * k and dimensions, one point at a time and in batches. checks both give the same labels, that update() puts every
+ * centroid at the mean of its points, and that a saved model loads back the same
+ */
+void bench::kmeansModel(long maxN) {
+    long n = std::min(maxN, 1000000L);
+    for (std::size_t dims : {2, 8, 16}) {
+        for (int k : {16, 256, 4096}) {
+            dataGen::Generator gen(dims, k, dims * k);
+            gen.spread = 20;
+            // centroids at the generator's centers, then new points from the same clusters to label
+            Dataset centroids(k, dims);
+            for (int c = 0; c < k; ++c) {
+                gen.center(c, centroids.row(c));
+            }
+            Dataset points = gen.generate(n);
+            KMeansModel scan(centroids.clone(), KMeansModel::Index::Scan);
+            KMeansModel tree(centroids.clone(), KMeansModel::Index::KDTree);
+            std::string name = " k=" + std::to_string(k) + " " + std::to_string(dims) + "d";
+
+            Clock::time_point start = Clock::now();
+            std::vector<int> scanLabels = scan.assignBatch(points);
+            report("KMeansModel::assignBatch scan" + name, n, secondsSince(start));
+            start = Clock::now();
+            std::vector<int> treeLabels = tree.assignBatch(points);
+            report("KMeansModel::assignBatch kdtree" + name, n, secondsSince(start));
+            if (scanLabels != treeLabels) {
+                bench::mismatch() << "scan and kdtree labels differ for" << name << std::endl;
+            }
+            KMeansModel automatic(centroids.clone());
+            long single = std::min(n, 10000L), sum = 0;
+            start = Clock::now();
+            for (long i = 0; i < single; ++i) {
+                sum += automatic.assign(points[i]);
+            }
+            double seconds = secondsSince(start);
+            report(std::string("KMeansModel::assign one point, ") + (automatic.usesTree() ? "kdtree" : "scan") + name,
+                   single, seconds);
+            std::cout << "    " << seconds / single * 1e6 << "us per point (label sum " << sum << ")" << std::endl;
+        }
+    }
+
+    // update from nothing: every centroid has to end up at the mean of the points it was given
+    dataGen::Generator gen(3, 100, 320);
+    Dataset centroids(100, 3);
+    for (int c = 0; c < 100; ++c) {
+        gen.center(c, centroids.row(c));
+    }
+    KMeansModel model(centroids.clone());
+    Dataset batch = gen.range(0, n);
+    Clock::time_point start = Clock::now();
+    std::vector<int> labels = model.update(batch);
+    report("KMeansModel::update", n, secondsSince(start));
+    std::vector<double> sums(100 * 3, 0.0);
+    std::vector<long> counts(100, 0);
+    for (long i = 0; i < n; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            sums[labels[i] * 3 + d] += batch[i][d];
+        }
+        ++counts[labels[i]];
+    }
+    double worst = 0;
+    for (int c = 0; c < 100; ++c) {
+        for (int d = 0; d < 3 && counts[c] > 0; ++d) {
+            worst = std::max(worst, std::abs(model.centroids().at(c, d) - sums[c * 3 + d] / counts[c]));
+        }
+    }
+    if (worst > 1e-9 || model.counts() != counts) {
+        bench::mismatch() << "updated centroids are off their means by " << worst << std::endl;
+    }
+    // a second batch only adds to what's there
+    start = Clock::now();
+    model.update(gen.range(n, 2 * n));
+    report("KMeansModel::update second batch", n, secondsSince(start));
+
+    std::string fileName = tempPath("bench_model.col");
+    model.save(fileName);
+    KMeansModel loaded = KMeansModel::load(fileName);
+    bool same = loaded.counts() == model.counts() && loaded.size() == model.size() && loaded.dim() == model.dim();
+    for (std::size_t c = 0; same && c < model.size(); ++c) {
+        for (std::size_t d = 0; d < model.dim(); ++d) {
+            same = same && loaded.centroids().at(c, d) == model.centroids().at(c, d);
+        }
+    }
+    if (!same) {
+        bench::mismatch() << "saved model loads back different" << std::endl;
+    }
+    std::remove(fileName.c_str());
+}
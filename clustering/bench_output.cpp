@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "asyncwriter.h"
+#include "bench.h"
+#include "csv.h"
+#include "generator.h"
+
+/*
+ * writing clustering results, every point with its label: the old way (std::ofstream and <<, one value at a time)
+ * against AsyncWriter. also checks that AsyncWriter's text reads back as exactly the values that were written
+ */
+void bench::output(long maxN) {
+    for (long n = 10000; n <= maxN; n *= 10) {
+        dataGen::Generator gen(2, 10, 320);
+        Dataset data = gen.generate(n);
+        std::string oldName = tempPath("bench_output_old.csv"), newName = tempPath("bench_output_new.csv");
+
+        Clock::time_point start = Clock::now();
+        std::ofstream oldFile(oldName);
+        for (long i = 0; i < n; ++i) {
+            oldFile << data.at(i, 0) << "," << data.at(i, 1) << "," << gen.label(i) << "\n";
+        }
+        oldFile.close();
+        report("std::ofstream <<", n, secondsSince(start), std::filesystem::file_size(oldName));
+
+        start = Clock::now();
+        AsyncWriter out(newName);
+        for (long i = 0; i < n; ++i) {
+            out.number(data.at(i, 0));
+            out.put(',');
+            out.number(data.at(i, 1));
+            out.put(',');
+            out.number((long) gen.label(i));
+            out.put('\n');
+        }
+        out.close();
+        report("AsyncWriter", n, secondsSince(start), std::filesystem::file_size(newName));
+
+        Dataset back = csv::parseMapped(newName, ',');
+        bool same = back.size() == data.size() && back.dim() == 3;
+        for (long i = 0; same && i < n; ++i) {
+            same = back.at(i, 0) == data.at(i, 0) && back.at(i, 1) == data.at(i, 1) && back.at(i, 2) == gen.label(i);
+        }
+        if (!same) {
+            bench::mismatch() << "AsyncWriter output doesn't read back what was written" << std::endl;
+        }
+        std::remove(oldName.c_str());
+        std::remove(newName.c_str());
+    }
+}
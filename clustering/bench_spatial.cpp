@@ -0,0 +1,108 @@
+#include <cmath>
+#include <iostream>
+#include "bench.h"
+#include "datagen.h"
+#include "dbscan.h"
+#include "generator.h"
+#include "spatial.h"
+
+/*
+ * neighbor search scaling: build each index on clustered data and run a radius query from every point,
+ * which is exactly the work DBscan::scan does. the area grows with n so density (and neighbors per point) stays
+ * about the same, otherwise the output size alone would be quadratic.
+ * brute force only runs on the small sizes because it's O(n^2). then the same in 12 dimensions, where the grid's
+ * 3^12 cells per query outnumber the occupied ones and it has to scan those instead
+ */
+void bench::spatialIndex(long maxN) {
+    const double maxDist = 10;
+    for (long n = 1000; n <= maxN; n *= 10) {
+        int side = 10 * std::sqrt(n);
+        int numClusters = 10;
+        int numNoise = n / 10;
+        Dataset data = dataGen::generateClusters(
+                side, side, 0, 0, (n - numNoise) / numClusters, numClusters, numNoise, side / 20.0);
+
+        long gridFound = 0, treeFound = 0;
+        std::vector<int> found;
+
+        Clock::time_point start = Clock::now();
+        spatial::UniformGrid grid(data, maxDist);
+        for (PointView pt : data) {
+            grid.radius(pt.data(), maxDist, found);
+            gridFound += found.size();
+        }
+        report("grid radius", data.size(), secondsSince(start));
+
+        start = Clock::now();
+        spatial::KDTree tree(data);
+        for (PointView pt : data) {
+            tree.radius(pt.data(), maxDist, found);
+            treeFound += found.size();
+        }
+        report("kdtree radius", data.size(), secondsSince(start));
+
+        start = Clock::now();
+        long knnFound = 0;
+        for (PointView pt : data) {
+            knnFound += tree.nearest(pt.data(), 8).size();
+        }
+        report("kdtree 8-nearest", data.size(), secondsSince(start));
+
+        if (gridFound != treeFound) {
+            bench::mismatch() << "grid found " << gridFound << ", kd tree found " << treeFound << std::endl;
+        }
+
+        if (n <= 10000) {
+            long bruteFound = 0;
+            start = Clock::now();
+            for (PointView a : data) {
+                for (PointView b : data) {
+                    if (dataGen::distance(a, b) < maxDist) {
+                        ++bruteFound;
+                    }
+                }
+            }
+            report("brute force radius", data.size(), secondsSince(start));
+            if (bruteFound != gridFound) {
+                bench::mismatch() << "brute force found " << bruteFound << ", grid found " << gridFound << std::endl;
+            }
+
+            start = Clock::now();
+            DBscan(maxDist, 5, spatial::IndexType::Grid).scan(data);
+            report("DBscan::scan grid", data.size(), secondsSince(start));
+            start = Clock::now();
+            DBscan(maxDist, 5, spatial::IndexType::BruteForce).scan(data);
+            report("DBscan::scan brute force", data.size(), secondsSince(start));
+        }
+    }
+
+    dataGen::Generator gen(12, 10, 12);
+    gen.spread = 3; // a dozen or so neighbors per point within maxDist
+    Dataset data = gen.generate(std::min(maxN, 2000L));
+    long gridFound = 0, treeFound = 0, bruteFound = 0;
+    std::vector<int> found;
+    Clock::time_point start = Clock::now();
+    spatial::UniformGrid grid(data, maxDist);
+    for (PointView pt : data) {
+        grid.radius(pt.data(), maxDist, found);
+        gridFound += found.size();
+    }
+    report("grid radius 12d", data.size(), secondsSince(start));
+    spatial::KDTree tree(data);
+    for (PointView pt : data) {
+        tree.radius(pt.data(), maxDist, found);
+        treeFound += found.size();
+    }
+    for (PointView a : data) {
+        for (PointView b : data) {
+            bruteFound += dataGen::distance(a, b) < maxDist;
+        }
+    }
+    if (gridFound != bruteFound || treeFound != bruteFound) {
+        bench::mismatch() << "12d: brute force found " << bruteFound << ", grid " << gridFound << ", kd tree "
+                          << treeFound << std::endl;
+    }
+    start = Clock::now();
+    DBscan(maxDist, 5, spatial::IndexType::Grid).scan(data);
+    report("DBscan::scan grid 12d", data.size(), secondsSince(start));
+}
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include "bench.h"
+#include "table.h"
+
+/*
+ * csv::Table::read on a file shaped like the UCI student data: a header, ';' separators, quoted strings, numbers
+ * (some of them quoted) and a mostly numeric column with a few strings in it, which has to end up categorical.
+ * checks the inferred types, that the codes decode back to what was written (including the rows of the mixed column
+ * read as numbers before its first string), and that the one hot view matches its materialized copy
+ */
+void bench::typedCSV(long maxN) {
+    const char *schools[] = {"GP", "MS"};
+    const char *jobs[] = {"at_home", "health", "other", "services", "teacher"};
+    for (long n = 1000; n <= maxN; n *= 10) {
+        std::string fileName = tempPath("bench_table_" + std::to_string(n) + ".csv");
+        std::vector<int> school(n), job(n);
+        std::vector<std::string> mixed(n);
+        {
+            std::mt19937 gen(320);
+            std::ofstream out(fileName);
+            out << "school;age;Mjob;G1;mixed\n";
+            for (long i = 0; i < n; ++i) {
+                school[i] = gen() % 2;
+                job[i] = gen() % 5;
+                out << '"' << schools[school[i]] << "\";" << 15 + gen() % 8 << ";\"" << jobs[job[i]] << "\";\""
+                    << gen() % 20 << "\";";
+                mixed[i] = i == n / 2 ? "n/a" : std::to_string(gen() % 100);
+                out << (i == n / 2 ? "\"n/a\"" : mixed[i]) << "\n";
+            }
+        }
+        long bytes = std::filesystem::file_size(fileName);
+
+        Clock::time_point start = Clock::now();
+        csv::Table table = csv::Table::read(fileName, ';');
+        report("csv::Table::read", table.size(), secondsSince(start), bytes);
+        start = Clock::now();
+        csv::OneHotView oneHot = table.oneHot();
+        Dataset expanded = oneHot.toDataset();
+        report("one hot toDataset", table.size(), secondsSince(start));
+
+        using csv::ColumnType;
+        bool same = table.size() == (std::size_t) n && table.numColumns() == 5 &&
+                    table.column("school").type == ColumnType::Categorical &&
+                    table.column("age").type == ColumnType::Numeric &&
+                    table.column("Mjob").type == ColumnType::Categorical &&
+                    table.column("G1").type == ColumnType::Numeric &&
+                    table.column("mixed").type == ColumnType::Categorical && oneHot.dim() == expanded.dim();
+        for (long i = 0; same && i < n; ++i) {
+            const csv::Table::Column &s = table.column("school"), &j = table.column("Mjob"), &m = table.column("mixed");
+            same = s.dictionary[s.codes[i]] == schools[school[i]] && j.dictionary[j.codes[i]] == jobs[job[i]] &&
+                   m.dictionary[m.codes[i]] == mixed[i] &&
+                   oneHot.row(i) == std::vector<double>(expanded[i].begin(), expanded[i].end());
+        }
+        if (!same) {
+            bench::mismatch() << "typed csv read back wrong from " << fileName << std::endl;
+        }
+        std::cout << "    " << table.numColumns() << " columns, " << oneHot.dim() << " one hot" << std::endl;
+        std::remove(fileName.c_str());
+    }
+}
@@ -0,0 +1,82 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "simd.h"
+
+/*
+ * usage: benchmarks [--max-n N] [--json FILE] [name ...]
+ * runs every benchmark if no names are given. exits 1 for a name that isn't a benchmark, or if any benchmark printed
+ * a MISMATCH. --json also writes every result to FILE, for comparing runs
+ */
+
+namespace {
+    struct Benchmark {
+        const char *name;
+        void (*run)(long maxN);
+    };
+
+    const Benchmark benchmarks[] = {
+            {"spatial", bench::spatialIndex},
+            {"csv", bench::csvParse},
+            {"table", bench::typedCSV},
+            {"kmeans", bench::kmeans},
+            {"kmeans-threads", bench::kmeansThreads},
+            {"kmeans-seeding", bench::kmeansSeeding},
+            {"minibatch", bench::miniBatchKMeans},
+            {"kmeans-model", bench::kmeansModel},
+            {"dbscan", bench::dbscan},
+            {"metrics", bench::metrics},
+            {"generator", bench::generator},
+            {"output", bench::output},
+    };
+}
+
+int main(int argc, char **argv) {
+    long maxN = 1000000;
+    std::string jsonPath;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--max-n") == 0 && i + 1 < argc) {
+            maxN = std::atol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            names.push_back(argv[i]);
+        }
+    }
+    for (const std::string &name : names) {
+        bool known = false;
+        for (const Benchmark &b : benchmarks) {
+            known = known || name == b.name;
+        }
+        if (!known) {
+            std::cerr << "no benchmark called " << name << ", they are:";
+            for (const Benchmark &b : benchmarks) {
+                std::cerr << " " << b.name;
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+    for (const Benchmark &b : benchmarks) {
+        bool wanted = names.empty();
+        for (const std::string &name : names) {
+            wanted = wanted || name == b.name;
+        }
+        if (wanted) {
+            std::cout << "== " << b.name << std::endl;
+            bench::start(b.name);
+            b.run(maxN);
+        }
+    }
+    if (!jsonPath.empty()) {
+        bench::writeJSON(jsonPath, "clustering", maxN, {{"kernel", simd::kernelName()}});
+    }
+    for (const std::string &name : bench::failed()) {
+        std::cerr << name << " FAILED" << std::endl;
+    }
+    return bench::failed().empty() ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "columnar.h"
+#include "csv.h"
+#include "threadpool.h"
+
+namespace {
+    const char magic[8] = {'C', 'S', '3', '2', '0', 'C', 'O', 'L'};
+    const std::uint32_t version = 1, byteOrderMark = 0x01020304;
+    const std::size_t alignment = 64, maxName = 56;
+
+    std::size_t padded(std::size_t bytes) {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    // where column j starts, for a file with numColumns columns of rows values
+    std::size_t columnOffset(std::size_t j, std::size_t rows, std::size_t numColumns) {
+        return alignment + numColumns * alignment + j * padded(rows * sizeof(double));
+    }
+
+    template <typename T>
+    void put(char *out, T value) {
+        std::memcpy(out, &value, sizeof(T));
+    }
+
+    template <typename T>
+    T get(const char *in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return value;
+    }
+
+    // everything before the first column
+    std::vector<char> makeHeader(std::size_t rows, std::size_t dims, const std::vector<std::string> &names) {
+        if (!names.empty() && names.size() != dims) {
+            throw std::invalid_argument("columnar: " + std::to_string(names.size()) + " names for " +
+                                        std::to_string(dims) + " columns");
+        }
+        std::vector<char> header(alignment + dims * alignment, 0);
+        std::memcpy(header.data(), magic, sizeof(magic));
+        put<std::uint32_t>(&header[8], version);
+        put<std::uint32_t>(&header[12], byteOrderMark);
+        put<std::uint64_t>(&header[16], rows);
+        put<std::uint32_t>(&header[24], dims);
+        for (std::size_t j = 0; j < dims; ++j) {
+            char *schema = &header[alignment + j * alignment];
+            std::string name = names.empty() ? "" : names[j].substr(0, maxName);
+            put<std::uint32_t>(schema, (std::uint32_t) columnar::Type::Float64);
+            put<std::uint32_t>(schema + 4, name.size());
+            std::memcpy(schema + 8, name.data(), name.size());
+        }
+        return header;
+    }
+
+    void writeAt(int fd, const char *data, std::size_t bytes, std::size_t offset, const std::string &path) {
+        while (bytes > 0) {
+            ssize_t written = pwrite(fd, data, bytes, offset);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                throw std::runtime_error("failed writing " + path + ": " + std::strerror(errno));
+            }
+            data += written;
+            bytes -= written;
+            offset += written;
+        }
+    }
+}
+
+void columnar::save(const Dataset &data, const std::string &path, const std::vector<std::string> &names) {
+    std::size_t rows = data.size(), dims = data.dim();
+    std::vector<char> header = makeHeader(rows, dims, names);
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("can't open " + tempPath);
+    }
+    out.write(header.data(), header.size());
+    // row major data gets gathered into a column a block at a time
+    const std::size_t blockRows = 1 << 16;
+    std::vector<double> block(std::min(rows, blockRows));
+    const char zeros[alignment] = {};
+    for (std::size_t j = 0; j < dims; ++j) {
+        if (data.layout() == Layout::ColumnMajor) {
+            out.write(reinterpret_cast<const char *>(data.column(j)), rows * sizeof(double));
+        } else {
+            for (std::size_t begin = 0; begin < rows; begin += blockRows) {
+                std::size_t end = std::min(rows, begin + blockRows);
+                for (std::size_t i = begin; i < end; ++i) {
+                    block[i - begin] = data.data()[i * dims + j];
+                }
+                out.write(reinterpret_cast<const char *>(block.data()), (end - begin) * sizeof(double));
+            }
+        }
+        out.write(zeros, padded(rows * sizeof(double)) - rows * sizeof(double));
+    }
+    out.close();
+    if (!out) {
+        std::filesystem::remove(tempPath);
+        throw std::runtime_error("failed writing " + tempPath);
+    }
+    std::filesystem::rename(tempPath, path);
+}
+
+columnar::Writer::Writer(const std::string &path_, std::size_t rows_, std::size_t dims_,
+                         const std::vector<std::string> &names)
+        : path(path_), tempPath(path_ + ".tmp"), rows(rows_), dims(dims_) {
+    std::vector<char> header = makeHeader(rows, dims, names);
+    fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("can't open " + tempPath + ": " + std::strerror(errno));
+    }
+    // the padding between columns is the zeros ftruncate fills in
+    if (ftruncate(fd, columnOffset(dims, rows, dims)) != 0) {
+        int err = errno;
+        ::close(fd);
+        fd = -1;
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("can't size " + tempPath + ": " + std::strerror(err));
+    }
+    writeAt(fd, header.data(), header.size(), 0, tempPath);
+}
+
+columnar::Writer::~Writer() {
+    if (fd >= 0) {
+        ::close(fd);
+        std::remove(tempPath.c_str());
+    }
+}
+
+void columnar::Writer::write(std::size_t firstRow, DatasetView points) {
+    if (points.dim() != dims || firstRow + points.size() > rows) {
+        throw std::invalid_argument("columnar::Writer::write: rows [" + std::to_string(firstRow) + ", " +
+                                    std::to_string(firstRow + points.size()) + ") of dimension " +
+                                    std::to_string(points.dim()) + " don't fit in " + std::to_string(rows) + " x " +
+                                    std::to_string(dims));
+    }
+    std::vector<double> column(points.size());
+    for (std::size_t j = 0; j < dims; ++j) {
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            column[i] = points.data()[i * dims + j];
+        }
+        writeAt(fd, reinterpret_cast<const char *>(column.data()), column.size() * sizeof(double),
+                columnOffset(j, rows, dims) + firstRow * sizeof(double), tempPath);
+    }
+}
+
+void columnar::Writer::close() {
+    if (::close(fd) != 0) {
+        fd = -1;
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("failed writing " + tempPath + ": " + std::strerror(errno));
+    }
+    fd = -1;
+    std::filesystem::rename(tempPath, path);
+}
+
+columnar::MappedDataset::MappedDataset(const std::string &path) : file(path) {
+    const char *base = file.data();
+    if (file.size() < alignment || std::memcmp(base, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error(path + " isn't a dataset file");
+    }
+    if (get<std::uint32_t>(base + 8) != version) {
+        throw std::runtime_error(path + " is dataset file version " + std::to_string(get<std::uint32_t>(base + 8)) +
+                                 ", expected " + std::to_string(version));
+    }
+    if (get<std::uint32_t>(base + 12) != byteOrderMark) {
+        throw std::runtime_error(path + " was written on a machine with a different byte order");
+    }
+    rows = get<std::uint64_t>(base + 16);
+    std::size_t dims = get<std::uint32_t>(base + 24);
+    // the first two keep a garbage header from overflowing the size calculation
+    if (dims > file.size() / alignment || rows > file.size() / sizeof(double) ||
+        file.size() < columnOffset(dims, rows, dims)) {
+        throw std::runtime_error(path + " is truncated: " + std::to_string(file.size()) + " bytes, expected " +
+                                 std::to_string(columnOffset(dims, rows, dims)));
+    }
+    for (std::size_t j = 0; j < dims; ++j) {
+        const char *schema = base + alignment + j * alignment;
+        Column column;
+        column.type = (Type) get<std::uint32_t>(schema);
+        if (column.type != Type::Float64) {
+            throw std::runtime_error(path + ": column " + std::to_string(j) + " has unknown type " +
+                                     std::to_string((std::uint32_t) column.type));
+        }
+        column.name.assign(schema + 8, std::min<std::size_t>(get<std::uint32_t>(schema + 4), maxName));
+        columns.push_back(column);
+        starts.push_back(reinterpret_cast<const double *>(base + columnOffset(j, rows, dims)));
+    }
+}
+
+Dataset columnar::MappedDataset::toDataset(Layout layout, int numThreads) const {
+    std::size_t dims = dim();
+    Dataset data(rows, dims, layout);
+    ThreadPool pool(numThreads);
+    if (layout == Layout::ColumnMajor) {
+        pool.forEach(dims, [&](std::size_t j, int) {
+            std::memcpy(data.column(j), starts[j], rows * sizeof(double));
+        });
+    } else {
+        pool.parallelFor(rows, [&](std::size_t begin, std::size_t end, int) {
+            double *out = data.data();
+            for (std::size_t i = begin; i < end; ++i) {
+                for (std::size_t j = 0; j < dims; ++j) {
+                    out[i * dims + j] = starts[j][i];
+                }
+            }
+        });
+    }
+    return data;
+}
+
+Dataset columnar::load(const std::string &path, Layout layout, int numThreads) {
+    return MappedDataset(path).toDataset(layout, numThreads);
+}
+
+Dataset columnar::loadCSV(const std::string &csvPath, char sep, const std::string &cachePath, int numThreads) {
+    namespace fs = std::filesystem;
+    std::error_code err;
+    if (fs::exists(cachePath, err) && fs::last_write_time(cachePath, err) >= fs::last_write_time(csvPath)) {
+        try {
+            return load(cachePath, Layout::RowMajor, numThreads);
+        } catch (const std::runtime_error &) {
+            // corrupt or from an older version, just make it again
+        }
+    }
+    Dataset data = csv::parseMapped(csvPath, sep, numThreads);
+    try {
+        save(data, cachePath);
+    } catch (const std::runtime_error &) {
+        // no cache next time, but the data is fine
+    }
+    return data;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dataset.h"
+#include "mappedfile.h"
+
+/*
+ * binary columnar dataset files, so a dataset only has to be parsed out of text once. loading one is a mmap and a
+ * copy instead of parsing every number again. the file (all native endian):
+ *   64 byte header: magic "CS320COL", u32 version, u32 byte order mark 0x01020304, u64 rows, u32 columns,
+ *   zero padded
+ *   64 bytes of schema per column: u32 type, u32 name length, then the name (up to 56 bytes), zero padded
+ *   then every column's values back to back, each one zero padded to a multiple of 64 bytes, so every column starts
+ *   64 byte aligned in the mapping
+ */
+namespace columnar {
+    enum class Type : std::uint32_t {
+        Float64 = 1
+    };
+
+    struct Column {
+        std::string name;
+        Type type = Type::Float64;
+    };
+
+    // names are optional (one per column if given, at most 56 bytes each). throws std::runtime_error if the file
+    // can't be written. writes to a temporary file and renames it over path, so path is never half written
+    void save(const Dataset &data, const std::string &path, const std::vector<std::string> &names = {});
+
+    /*
+     * writes a dataset file a piece at a time, for data that never has to be in memory all at once. the file is
+     * made at its full size up front, so any number of threads can write different rows at the same time. it only
+     * shows up at path once close() is called
+     */
+    class Writer {
+    public:
+        // throws std::runtime_error if the file can't be made
+        Writer(const std::string &path_, std::size_t rows_, std::size_t dims_,
+               const std::vector<std::string> &names = {});
+        ~Writer(); // without close() the file is thrown away
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        // points (row major, dims wide) become rows [firstRow, firstRow + points.size())
+        void write(std::size_t firstRow, DatasetView points);
+        void close();
+
+    private:
+        std::string path, tempPath;
+        std::size_t rows, dims;
+        int fd = -1;
+    };
+
+    // a dataset file mapped into memory, columns read in place
+    class MappedDataset {
+    public:
+        // throws std::runtime_error if it can't be opened or isn't a complete dataset file
+        explicit MappedDataset(const std::string &path);
+
+        std::size_t size() const { return rows; }
+        std::size_t dim() const { return columns.size(); }
+        const std::vector<Column> &schema() const { return columns; }
+        const double *column(std::size_t j) const { return starts[j]; }
+
+        // copies it into a Dataset of either layout, across numThreads threads (0 = one per core)
+        Dataset toDataset(Layout layout = Layout::RowMajor, int numThreads = 0) const;
+
+    private:
+        MappedFile file;
+        std::size_t rows = 0;
+        std::vector<Column> columns;
+        std::vector<const double *> starts;
+    };
+
+    Dataset load(const std::string &path, Layout layout = Layout::RowMajor, int numThreads = 0);
+
+    /*
+     * csv::parseMapped(csvPath, sep), with cachePath as a cache: if it's at least as new as the csv it gets loaded
+     * instead, otherwise (or if it's unreadable) the csv is parsed and saved to cachePath for next time
+     */
+    Dataset loadCSV(const std::string &csvPath, char sep, const std::string &cachePath, int numThreads = 0);
+}
@@ -1,15 +1,29 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <thread>
 #include "csv.h"
+#include "instrument.h"
+#include "mappedfile.h"
 
 using namespace csv;
 
-std::vector<std::vector<double>> csv::parse(std::string fileName, char sep) {
+// line 0 means the problem isn't in any particular line (like the file not opening)
+csv::ParseError::ParseError(const std::string &fileName_, long line_, long column_, const std::string &problem)
+        : std::runtime_error(line_ == 0 ? problem : fileName_ + ":" + std::to_string(line_) + ":" +
+                                                    std::to_string(column_) + ": " + problem),
+          fileName(fileName_), line(line_), column(column_) {}
+
+Dataset csv::parse(std::string fileName, char sep) {
+    INSTRUMENT_PHASE("csv.parse");
     std::ifstream inFile(fileName);
-    std::vector<std::vector<double>> data;
+    Dataset data;
     std::string strLine;
+    std::vector<double> vecLine;
     if (inFile.is_open()) {
         while (getline(inFile, strLine)) {
             std::string tempVal = "";
-            std::vector<double> vecLine;
+            vecLine.clear();
             for (char c : strLine) {
                 if (c != sep) {
                     tempVal += c;
@@ -18,9 +32,305 @@ std::vector<std::vector<double>> csv::parse(std::string fileName, char sep) {
                     tempVal = "";
                 }
             }
-            data.push_back(vecLine);
+            // lines without a trailing sep still have a value left over
+            if (tempVal.find_first_not_of(" \t\r") != std::string::npos) {
+                vecLine.push_back(std::stod(tempVal));
+            }
+            if (!vecLine.empty()) {
+                data.push(vecLine); // throws if this line has a different number of values than the first one
+            }
         }
         inFile.close();
     }
+    INSTRUMENT_COUNT("csv.rows", data.size());
+    return data;
+}
+
+namespace {
+    // a piece of the file that starts at the beginning of a line and ends right after a '\n' (or at the end of file)
+    struct Chunk {
+        const char *begin, *end;
+        long rows = 0; // non blank lines
+        long lines = 0; // all lines, for error messages
+        long firstRow = 0, firstLine = 0; // filled in once every chunk has been counted
+        bool failed = false;
+        long errLine = 0, errColumn = 0;
+        std::string errProblem;
+    };
+
+    bool isBlank(const char *begin, const char *end) {
+        for (const char *p = begin; p < end; ++p) {
+            if (*p != ' ' && *p != '\t' && *p != '\r') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char *skipSpaces(const char *p, const char *end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char *lineEnd(const char *p, const char *end) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        return newline == nullptr ? end : newline;
+    }
+
+    /*
+     * parses one line into out (which has room for dims values). returns the number of values found, or -1 with
+     * errAt/problem set if something in the line isn't a number. if out is null it only counts, for the first line
+     */
+    long parseLine(const char *p, const char *end, char sep, double *out, long dims, const char *&errAt,
+                   std::string &problem) {
+        long count = 0;
+        while (true) {
+            p = skipSpaces(p, end);
+            if (p == end) {
+                // empty field at the end: either a blank line (already skipped) or a trailing sep, both are fine
+                return count;
+            }
+            if (*p == '+') {
+                ++p; // from_chars doesn't take a leading +
+            }
+            double val;
+            std::from_chars_result result = std::from_chars(p, end, val);
+            if (result.ec != std::errc()) {
+                errAt = p;
+                problem = result.ec == std::errc::result_out_of_range ? "number out of range" : "expected a number";
+                return -1;
+            }
+            if (out != nullptr) {
+                if (count == dims) {
+                    errAt = p;
+                    problem = "too many values, expected " + std::to_string(dims);
+                    return -1;
+                }
+                out[count] = val;
+            }
+            ++count;
+            p = skipSpaces(result.ptr, end);
+            if (p == end) {
+                return count;
+            }
+            if (*p != sep) {
+                errAt = p;
+                problem = std::string("expected '") + sep + "' or end of line";
+                return -1;
+            }
+            ++p;
+        }
+    }
+
+    void countLines(Chunk &chunk) {
+        for (const char *p = chunk.begin; p < chunk.end;) {
+            const char *end = lineEnd(p, chunk.end);
+            ++chunk.lines;
+            if (!isBlank(p, end)) {
+                ++chunk.rows;
+            }
+            p = end + 1;
+        }
+    }
+
+    void parseChunk(Chunk &chunk, char sep, Dataset &data) {
+        long row = chunk.firstRow, line = chunk.firstLine;
+        long dims = data.dim();
+        std::string problem;
+        const char *errAt = nullptr;
+        for (const char *p = chunk.begin; p < chunk.end; ++line) {
+            const char *end = lineEnd(p, chunk.end);
+            if (!isBlank(p, end)) {
+                long found = parseLine(p, end, sep, data.row(row), dims, errAt, problem);
+                if (found >= 0 && found != dims) {
+                    errAt = end;
+                    problem = "too few values, expected " + std::to_string(dims) + " but found " + std::to_string(found);
+                    found = -1;
+                }
+                if (found < 0) {
+                    // stop at the first error, later chunks might have earlier ones and the caller sorts that out
+                    chunk.failed = true;
+                    chunk.errLine = line + 1;
+                    chunk.errColumn = errAt - p + 1;
+                    chunk.errProblem = problem;
+                    return;
+                }
+                ++row;
+            }
+            p = end + 1;
+        }
+    }
+}
+
+Dataset csv::parseMapped(const std::string &fileName, char sep, int numThreads) {
+    INSTRUMENT_PHASE("csv.parseMapped");
+    MappedFile file;
+    try {
+        file = MappedFile(fileName);
+    } catch (const std::runtime_error &e) {
+        throw ParseError(fileName, 0, 0, e.what());
+    }
+    const char *begin = file.data(), *end = begin + file.size();
+
+    // the first non blank line decides the dimension
+    const char *first = begin;
+    long firstLineNum = 1;
+    while (first < end && isBlank(first, lineEnd(first, end))) {
+        first = lineEnd(first, end) + 1;
+        ++firstLineNum;
+    }
+    if (first >= end) {
+        return Dataset();
+    }
+    std::string problem;
+    const char *errAt = nullptr;
+    long dims = parseLine(first, lineEnd(first, end), sep, nullptr, 0, errAt, problem);
+    if (dims < 0) {
+        throw ParseError(fileName, firstLineNum, errAt - first + 1, problem);
+    }
+
+    // split into chunks that end on line breaks. small files aren't worth the threads
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::size_t minChunkBytes = 1 << 20;
+    std::size_t numChunks = std::max<std::size_t>(1, std::min<std::size_t>(numThreads, file.size() / minChunkBytes));
+    std::vector<Chunk> chunks;
+    const char *chunkStart = begin;
+    for (std::size_t i = 1; i <= numChunks && chunkStart < end; ++i) {
+        const char *chunkEnd = i == numChunks ? end : std::min(end, lineEnd(begin + file.size() * i / numChunks, end) + 1);
+        if (chunkEnd > chunkStart) {
+            Chunk chunk;
+            chunk.begin = chunkStart;
+            chunk.end = chunkEnd;
+            chunks.push_back(chunk);
+            chunkStart = chunkEnd;
+        }
+    }
+
+    // pass 1: count rows per chunk so every chunk knows where its rows go in the output
+    auto runAll = [&](auto work) {
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < chunks.size(); ++i) {
+            threads.emplace_back(work, std::ref(chunks[i]));
+        }
+        work(chunks[0]);
+        for (std::thread &t : threads) {
+            t.join();
+        }
+    };
+    runAll(countLines);
+    long rows = 0, lines = 0;
+    for (Chunk &chunk : chunks) {
+        chunk.firstRow = rows;
+        chunk.firstLine = lines;
+        rows += chunk.rows;
+        lines += chunk.lines;
+    }
+
+    // pass 2: parse every chunk straight into its rows
+    Dataset data(rows, dims);
+    runAll([&](Chunk &chunk) { parseChunk(chunk, sep, data); });
+    for (const Chunk &chunk : chunks) {
+        if (chunk.failed) {
+            throw ParseError(fileName, chunk.errLine, chunk.errColumn, chunk.errProblem);
+        }
+    }
+    INSTRUMENT_COUNT("csv.rows", rows);
+    INSTRUMENT_COUNT("csv.bytes", file.size());
     return data;
-}
\ No newline at end of file
+}
+
+csv::Reader::Reader(const std::string &fileName_, char sep_, std::size_t bufferSize)
+        : fileName(fileName_), sep(sep_), in(fileName_, std::ios::binary), buffer(std::max<std::size_t>(bufferSize, 64)) {
+    if (!in.is_open()) {
+        throw ParseError(fileName, 0, 0, "can't open " + fileName);
+    }
+    // peek at the first non blank line for the dimension, then go back so next() starts at the top
+    const char *begin, *end;
+    while (nextLine(begin, end)) {
+        if (!isBlank(begin, end)) {
+            std::string problem;
+            const char *errAt = nullptr;
+            long found = parseLine(begin, end, sep, nullptr, 0, errAt, problem);
+            if (found < 0) {
+                throw ParseError(fileName, lineNum, errAt - begin + 1, problem);
+            }
+            dims = found;
+            break;
+        }
+    }
+    rewind();
+}
+
+void csv::Reader::rewind() {
+    in.clear();
+    in.seekg(0);
+    pos = filled = 0;
+    atEnd = false;
+    lineNum = 0;
+}
+
+void csv::Reader::refill() {
+    // keep the partial line that's left, and make room for more if it takes up the whole buffer
+    std::size_t left = filled - pos;
+    std::memmove(buffer.data(), buffer.data() + pos, left);
+    pos = 0;
+    filled = left;
+    if (filled == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+    in.read(buffer.data() + filled, buffer.size() - filled);
+    filled += in.gcount();
+    if (in.gcount() == 0) {
+        atEnd = true;
+    }
+}
+
+bool csv::Reader::nextLine(const char *&begin, const char *&end) {
+    while (true) {
+        const char *start = buffer.data() + pos, *stop = buffer.data() + filled;
+        const char *newline = static_cast<const char *>(std::memchr(start, '\n', stop - start));
+        if (newline != nullptr || (atEnd && start < stop)) {
+            begin = start;
+            end = newline != nullptr ? newline : stop;
+            pos = end - buffer.data() + (newline != nullptr ? 1 : 0);
+            ++lineNum;
+            return true;
+        }
+        if (atEnd) {
+            return false;
+        }
+        refill();
+    }
+}
+
+bool csv::Reader::next(Dataset &batch, std::size_t maxRows) {
+    if (batch.dim() != dims) {
+        batch = Dataset(0, dims);
+    }
+    batch.clear();
+    batch.reserve(maxRows);
+    row.resize(dims);
+    std::string problem;
+    const char *errAt = nullptr;
+    const char *begin, *end;
+    while (batch.size() < maxRows && nextLine(begin, end)) {
+        if (isBlank(begin, end)) {
+            continue;
+        }
+        long found = parseLine(begin, end, sep, row.data(), dims, errAt, problem);
+        if (found >= 0 && found != (long) dims) {
+            errAt = end;
+            problem = "too few values, expected " + std::to_string(dims) + " but found " + std::to_string(found);
+            found = -1;
+        }
+        if (found < 0) {
+            throw ParseError(fileName, lineNum, errAt - begin + 1, problem);
+        }
+        batch.push(PointView(row.data(), dims));
+    }
+    return !batch.empty();
+}
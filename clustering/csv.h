@@ -1,7 +1,55 @@
+#pragma once
+
 #include <vector>
 #include <string>
 #include <fstream>
+#include <stdexcept>
+#include "batchreader.h"
+#include "dataset.h"
 
 namespace csv {
-    std::vector<std::vector<double>> parse(std::string fileName, char sep);
-}
\ No newline at end of file
+    // thrown by parseMapped. line and column are 1 based, column counts characters not fields
+    class ParseError : public std::runtime_error {
+    public:
+        ParseError(const std::string &fileName_, long line_, long column_, const std::string &problem);
+        std::string fileName;
+        long line, column;
+    };
+
+    Dataset parse(std::string fileName, char sep);
+
+    /*
+     * same output as parse, but much faster on big files: the file is mmapped, split into chunks at line breaks,
+     * and each chunk is parsed on its own thread with std::from_chars straight into the Dataset.
+     * blank lines are skipped, a trailing sep at the end of a line is allowed, and every line has to have the same
+     * number of values as the first one. numThreads = 0 means one per core.
+     * throws ParseError (the first error in the file if there are several) instead of returning partial data
+     */
+    Dataset parseMapped(const std::string &fileName, char sep, int numThreads = 0);
+
+    /*
+     * reads a csv a batch at a time through a fixed size buffer, so memory use doesn't depend on the file size.
+     * same rules and errors as parseMapped
+     */
+    class Reader : public BatchReader {
+    public:
+        Reader(const std::string &fileName_, char sep_, std::size_t bufferSize = 1 << 20);
+        bool next(Dataset &batch, std::size_t maxRows) override;
+        void rewind() override;
+        std::size_t dim() const override { return dims; }
+
+    private:
+        bool nextLine(const char *&begin, const char *&end); // false at the end of the file
+        void refill();
+
+        std::string fileName;
+        char sep;
+        std::ifstream in;
+        std::vector<char> buffer;
+        std::size_t pos = 0, filled = 0; // unread data is buffer[pos, filled)
+        bool atEnd = false;
+        long lineNum = 0;
+        std::size_t dims = 0;
+        std::vector<double> row;
+    };
+}
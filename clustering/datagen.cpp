@@ -1,6 +1,10 @@
 #include <cmath>
 #include <iostream>
+#include <random>
+#include "asyncwriter.h"
 #include "datagen.h"
+#include "metric.h"
+#include "random.h"
 
 using namespace dataGen;
 
@@ -8,48 +12,68 @@ double dataGen::scaleBetween(double unscaledNum, double minAllowed, double maxAl
     return (maxAllowed - minAllowed) * (unscaledNum - min) / (max - min) + minAllowed;
 }
 
-double dataGen::distance(std::vector<double> p1, std::vector<double> p2) {
+double dataGen::distance(PointView p1, PointView p2) {
     // it returns nan sometimes. probably overflow. maybe I should use a dataset with a smaller range?
-    return sqrt(pow(p1[0] - p2[0], 2) + pow(p1[1] - p2[1], 2));
+    return metric::distance<metric::Euclidean>(p1, p2);
 }
 
-void dataGen::saveCSV(std::vector<std::vector<double>> data, std::string name) {
-    std::ofstream outFile(name + ".csv");
-    for (std::vector<double> row : data) {
+double dataGen::squaredDistance(PointView p1, PointView p2) {
+    return metric::distance<metric::SquaredEuclidean>(p1, p2);
+}
+
+// every value is followed by a comma, the csv parsers are fine with the one at the end of the line
+void dataGen::saveCSV(DatasetView data, std::string name) {
+    AsyncWriter out(name + ".csv");
+    for (PointView row : data) {
         for (double val : row) {
-            outFile << std::to_string(val) << ",";
+            out.number(val);
+            out.put(',');
         }
-        outFile << "\n";
+        out.put('\n');
     }
-    outFile.close();
+    out.close();
 }
 
-std::vector<std::vector<double>> dataGen::generateRandom(int maxX, int maxY, int minX, int minY, int numPts) {
-    std::srand(std::time(nullptr)); // current time = random seed
-    std::vector<std::vector<double>> data;
+std::uint64_t dataGen::randomSeed() {
+    static std::random_device device;
+    return ((std::uint64_t) device() << 32) ^ device();
+}
+
+Dataset dataGen::generateRandom(int maxX, int maxY, int minX, int minY, int numPts, std::uint64_t seed) {
+    std::uint64_t counter = 0;
+    auto random = [&](double min, double max) {
+        return scaleBetween(rng::uniform01(seed, counter++), min, max, 0, 1);
+    };
+    Dataset data(numPts, 2);
     for (int i = 0; i < numPts; ++i) {
-        data.push_back({scaleBetween(std::rand(), minX, maxX, 0, RAND_MAX),
-                        scaleBetween(std::rand(), minY, maxY, 0, RAND_MAX)});
+        data.at(i, 0) = random(minX, maxX);
+        data.at(i, 1) = random(minY, maxY);
     }
     return data;
 }
 
-std::vector<std::vector<double>>
-dataGen::generateClusters(int maxX, int maxY, int minX, int minY, int numPts, int numClusters, int numNoise, double spread) {
-    std::srand(std::time(nullptr)); // current time = random seed
-    std::vector<std::vector<double>> data;
+Dataset
+dataGen::generateClusters(int maxX, int maxY, int minX, int minY, int numPts, int numClusters, int numNoise, double spread,
+                          std::uint64_t seed) {
+    std::uint64_t counter = 0;
+    auto random = [&](double min, double max) {
+        return scaleBetween(rng::uniform01(seed, counter++), min, max, 0, 1);
+    };
+    Dataset data(numClusters * numPts + numNoise, 2);
+    int row = 0;
     for (int i = 0; i < numClusters; ++i) {
-        int clusterX = scaleBetween(std::rand(), minX, maxX, 0, RAND_MAX);
-        int clusterY = scaleBetween(std::rand(), minY, maxY, 0, RAND_MAX);
+        int clusterX = random(minX, maxX);
+        int clusterY = random(minY, maxY);
         for (int j = 0; j < numPts; ++j) {
-            data.push_back(
-                    {scaleBetween(std::rand(), clusterX - spread, clusterX + spread, 0, RAND_MAX),
-                     scaleBetween(std::rand(), clusterY - spread, clusterY + spread, 0, RAND_MAX)});
+            data.at(row, 0) = random(clusterX - spread, clusterX + spread);
+            data.at(row, 1) = random(clusterY - spread, clusterY + spread);
+            ++row;
         }
     }
     for (int i = 0; i < numNoise; ++i) {
-        data.push_back({scaleBetween(std::rand(), minX, maxX, 0, RAND_MAX),
-                        scaleBetween(std::rand(), minY, maxY, 0, RAND_MAX)});
+        data.at(row, 0) = random(minX, maxX);
+        data.at(row, 1) = random(minY, maxY);
+        ++row;
     }
     return data;
-}
\ No newline at end of file
+}
@@ -1,14 +1,20 @@
+#pragma once
+
+#include <cstdint>
 #include <fstream>
 #include <vector>
-#include <cstdlib>
-#include <ctime>
+#include "dataset.h"
 
 namespace dataGen { // also has some processing
-    void saveCSV(std::vector<std::vector<double>> data, std::string name);
+    void saveCSV(DatasetView data, std::string name);
+
+    std::uint64_t randomSeed(); // different every call, for when the data doesn't need to be reproducible
 
-    std::vector<std::vector<double>> generateRandom(int maxX, int maxY, int minX, int minY, int numPts);
+    // the same seed always gives the same points. see generator.h for more dimensions, more shapes and more points
+    Dataset generateRandom(int maxX, int maxY, int minX, int minY, int numPts, std::uint64_t seed = randomSeed());
     double scaleBetween(double unscaledNum, double minAllowed, double maxAllowed, double min, double max);
-    double distance(std::vector<double> p1, std::vector<double> p2);
+    double distance(PointView p1, PointView p2); // euclidean, any number of dimensions
+    double squaredDistance(PointView p1, PointView p2); // for comparisons, skips the sqrt
 
     /*
      * generates numClusters clusters at random locations.
@@ -16,6 +22,6 @@ namespace dataGen { // also has some processing
      * numPts specifies the number of points in a cluster
      * works well enough, but can go over min and max due to spread, but this is fine for my use
      */
-    std::vector<std::vector<double>>
-    generateClusters(int maxX, int maxY, int minX, int minY, int numPts, int numClusters, int numNoise, double spread);
-}
\ No newline at end of file
+    Dataset generateClusters(int maxX, int maxY, int minX, int minY, int numPts, int numClusters, int numNoise, double spread,
+                             std::uint64_t seed = randomSeed());
+}
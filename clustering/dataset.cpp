@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "dataset.h"
+
+Dataset::Dataset(std::size_t rows_, std::size_t dims_, Layout layout_) : values(rows_ * dims_), rows(rows_), dims(dims_),
+                                                                         order(layout_) {}
+
+Dataset::Dataset(Dataset &&other) noexcept : values(std::move(other.values)), rows(other.rows), dims(other.dims),
+                                             order(other.order) {
+    other.rows = 0;
+    other.dims = 0;
+}
+
+Dataset &Dataset::operator=(Dataset &&other) noexcept {
+    values = std::move(other.values);
+    rows = other.rows;
+    dims = other.dims;
+    order = other.order;
+    other.rows = 0;
+    other.dims = 0;
+    return *this;
+}
+
+Dataset Dataset::fromRows(const std::vector<std::vector<double>> &rows) {
+    Dataset data(rows.size(), rows.empty() ? 0 : rows[0].size());
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].size() != data.dims) {
+            throw std::invalid_argument("Dataset::fromRows: row " + std::to_string(i) + " has " +
+                                        std::to_string(rows[i].size()) + " values, expected " +
+                                        std::to_string(data.dims));
+        }
+        std::copy(rows[i].begin(), rows[i].end(), data.row(i));
+    }
+    return data;
+}
+
+Dataset Dataset::clone() const {
+    Dataset copy;
+    copy.values = values;
+    copy.rows = rows;
+    copy.dims = dims;
+    copy.order = order;
+    return copy;
+}
+
+Dataset Dataset::toLayout(Layout newLayout) const {
+    if (newLayout == order) {
+        return clone();
+    }
+    Dataset converted(rows, dims, newLayout);
+    for (std::size_t i = 0; i < rows; ++i) {
+        for (std::size_t j = 0; j < dims; ++j) {
+            converted.at(i, j) = at(i, j);
+        }
+    }
+    return converted;
+}
+
+void Dataset::push(PointView pt) {
+    assert(order == Layout::RowMajor);
+    if (rows == 0 && dims == 0) {
+        dims = pt.size();
+    }
+    if (pt.size() != dims) {
+        throw std::invalid_argument("Dataset::push: point has " + std::to_string(pt.size()) + " values, expected " +
+                                    std::to_string(dims));
+    }
+    values.insert(values.end(), pt.begin(), pt.end());
+    ++rows;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/*
+ * flat storage for n points of any dimension. replaces std::vector<std::vector<double>> so a dataset is one
+ * allocation instead of one per point, and distance loops walk contiguous memory.
+ * Dataset owns its values and can only be moved (use clone() when a copy is really wanted).
+ * PointView and DatasetView don't own anything, they're just pointers into a Dataset, so pass them by value.
+ */
+
+enum class Layout {
+    RowMajor, // point i is values[i * dim, (i + 1) * dim). what the clustering algorithms want
+    ColumnMajor // column j is values[j * size, (j + 1) * size). nicer for per-feature work and columnar files
+};
+
+class PointView {
+public:
+    PointView() = default;
+    PointView(const double *ptr_, std::size_t dims_) : ptr(ptr_), dims(dims_) {}
+
+    double operator[](std::size_t i) const { return ptr[i]; }
+    const double *data() const { return ptr; }
+    std::size_t size() const { return dims; }
+    const double *begin() const { return ptr; }
+    const double *end() const { return ptr + dims; }
+
+private:
+    const double *ptr = nullptr;
+    std::size_t dims = 0;
+};
+
+// a row major block of points, either a whole Dataset or a slice of one
+class DatasetView {
+public:
+    class iterator {
+    public:
+        iterator(const double *ptr_, std::size_t dims_) : ptr(ptr_), dims(dims_) {}
+        PointView operator*() const { return PointView(ptr, dims); }
+        iterator &operator++() {
+            ptr += dims;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const { return ptr != other.ptr; }
+    private:
+        const double *ptr;
+        std::size_t dims;
+    };
+
+    DatasetView() = default;
+    DatasetView(const double *ptr_, std::size_t rows_, std::size_t dims_) : ptr(ptr_), rows(rows_), dims(dims_) {}
+
+    PointView operator[](std::size_t i) const { return PointView(ptr + i * dims, dims); }
+    std::size_t size() const { return rows; }
+    std::size_t dim() const { return dims; }
+    bool empty() const { return rows == 0; }
+    const double *data() const { return ptr; }
+    DatasetView slice(std::size_t begin, std::size_t end) const { return DatasetView(ptr + begin * dims, end - begin, dims); }
+    iterator begin() const { return iterator(ptr, dims); }
+    iterator end() const { return iterator(ptr + rows * dims, dims); }
+
+private:
+    const double *ptr = nullptr;
+    std::size_t rows = 0, dims = 0;
+};
+
+class Dataset {
+public:
+    Dataset() = default;
+    Dataset(std::size_t rows_, std::size_t dims_, Layout layout_ = Layout::RowMajor);
+    Dataset(const Dataset &) = delete;
+    Dataset &operator=(const Dataset &) = delete;
+    Dataset(Dataset &&other) noexcept;
+    Dataset &operator=(Dataset &&other) noexcept;
+
+    static Dataset fromRows(const std::vector<std::vector<double>> &rows); // rows have to all be the same length
+    Dataset clone() const;
+    Dataset toLayout(Layout newLayout) const;
+
+    std::size_t size() const { return rows; }
+    std::size_t dim() const { return dims; }
+    bool empty() const { return rows == 0; }
+    Layout layout() const { return order; }
+    double *data() { return values.data(); }
+    const double *data() const { return values.data(); }
+
+    // element access that works for either layout
+    double &at(std::size_t i, std::size_t j) { return order == Layout::RowMajor ? values[i * dims + j] : values[j * rows + i]; }
+    double at(std::size_t i, std::size_t j) const { return order == Layout::RowMajor ? values[i * dims + j] : values[j * rows + i]; }
+
+    // row major only
+    PointView operator[](std::size_t i) const {
+        assert(order == Layout::RowMajor);
+        return PointView(values.data() + i * dims, dims);
+    }
+    double *row(std::size_t i) {
+        assert(order == Layout::RowMajor);
+        return values.data() + i * dims;
+    }
+    DatasetView view() const {
+        assert(order == Layout::RowMajor);
+        return DatasetView(values.data(), rows, dims);
+    }
+    operator DatasetView() const { return view(); }
+    DatasetView::iterator begin() const { return view().begin(); }
+    DatasetView::iterator end() const { return view().end(); }
+    void reserve(std::size_t numRows) { values.reserve(numRows * dims); }
+    // drops every point but keeps the dimension and the memory, for reusing a Dataset as a buffer
+    void clear() {
+        values.clear();
+        rows = 0;
+    }
+    // the first push into an empty 0 dimensional dataset sets the dimension
+    void push(PointView pt);
+    void push(const std::vector<double> &pt) { push(PointView(pt.data(), pt.size())); }
+
+    // column major only
+    const double *column(std::size_t j) const {
+        assert(order == Layout::ColumnMajor);
+        return values.data() + j * rows;
+    }
+    double *column(std::size_t j) {
+        assert(order == Layout::ColumnMajor);
+        return values.data() + j * rows;
+    }
+
+private:
+    std::vector<double> values;
+    std::size_t rows = 0, dims = 0;
+    Layout order = Layout::RowMajor;
+};
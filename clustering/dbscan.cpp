@@ -1,61 +1,352 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <cmath>
 #include "dbscan.h"
 #include "datagen.h"
+#include "instrument.h"
+#include "threadpool.h"
 
-Point::Point(std::vector<double> pos_, int id_) {
+namespace {
+    // the neighbors (other than itself) of point i go in out. safe to call from several threads at once
+    typedef std::function<void(int, std::vector<int> &)> NeighborQuery;
+    // just how many neighbors point i has, for when that's cheaper than listing them
+    typedef std::function<int(int, std::vector<int> &)> NeighborCount;
+
+    NeighborCount countByQuery(const NeighborQuery &neighbors) {
+        return [&neighbors](int i, std::vector<int> &scratch) {
+            neighbors(i, scratch);
+            return (int) scratch.size();
+        };
+    }
+
+    // builds the index for indexType and hands back a query that uses it. the index lives as long as the query
+    NeighborQuery euclideanQuery(DatasetView data, double maxDist, spatial::IndexType indexType) {
+        auto withoutSelf = [](int i, std::vector<int> &out) {
+            out.erase(std::remove(out.begin(), out.end(), i), out.end());
+        };
+        indexType = spatial::effectiveIndex(indexType, data.dim());
+        if (indexType == spatial::IndexType::Grid) {
+            auto grid = std::make_shared<spatial::UniformGrid>(data, maxDist);
+            return [=](int i, std::vector<int> &out) {
+                grid->radius(data[i].data(), maxDist, out);
+                withoutSelf(i, out);
+            };
+        }
+        if (indexType == spatial::IndexType::KDTree) {
+            auto tree = std::make_shared<spatial::KDTree>(data);
+            return [=](int i, std::vector<int> &out) {
+                tree->radius(data[i].data(), maxDist, out);
+                withoutSelf(i, out);
+            };
+        }
+        return [=](int i, std::vector<int> &out) {
+            out.clear();
+            for (int j = 0; j < (int) data.size(); ++j) {
+                if (j != i && dataGen::distance(data[i], data[j]) < maxDist) {
+                    out.push_back(j);
+                }
+            }
+        };
+    }
+
+    // same thing for any metric: candidates from a euclidean query that's sure to include every neighbor, then
+    // Metric's own check
+    template <typename Metric>
+    NeighborQuery makeQuery(DatasetView data, double maxDist, spatial::IndexType indexType) {
+        if constexpr (std::is_same<Metric, metric::Euclidean>::value) {
+            return euclideanQuery(data, maxDist, indexType);
+        } else {
+            return metric::withDims(data.dim(), [&](auto dimsConstant) -> NeighborQuery {
+                const std::size_t D = decltype(dimsConstant)::value;
+                std::size_t dims = data.dim();
+                auto closer = [=](int i, int j) {
+                    return Metric::template distance<D>(data[i].data(), data[j].data(), dims) < maxDist;
+                };
+                // nudged up so rounding in the index's squared distances can't lose anything right at the edge
+                double inf = std::numeric_limits<double>::infinity();
+                double radius = std::nextafter(Metric::euclideanRadius(maxDist), inf);
+                if (std::isinf(radius)) {
+                    return [=](int i, std::vector<int> &out) {
+                        out.clear();
+                        for (int j = 0; j < (int) data.size(); ++j) {
+                            if (j != i && closer(i, j)) {
+                                out.push_back(j);
+                            }
+                        }
+                    };
+                }
+                NeighborQuery candidates = euclideanQuery(data, radius, indexType);
+                return [=](int i, std::vector<int> &out) {
+                    candidates(i, out);
+                    out.erase(std::remove_if(out.begin(), out.end(), [&](int j) { return !closer(i, j); }),
+                              out.end());
+                };
+            });
+        }
+    }
+
+    /*
+     * union find that any number of threads can use at once without locks. a set's root is the element that's its
+     * own parent. roots only ever get linked under smaller roots, with a compare and swap that fails if the root
+     * stopped being one in the meantime, and finds halve the path as they go (a lost race there just means a bit
+     * less halving)
+     */
+    class ConcurrentUnionFind {
+    public:
+        explicit ConcurrentUnionFind(int n) : parent(n) {
+            for (int i = 0; i < n; ++i) {
+                parent[i].store(i, std::memory_order_relaxed);
+            }
+        }
+
+        int find(int x) {
+            while (true) {
+                int p = parent[x].load(std::memory_order_acquire);
+                if (p == x) {
+                    return x;
+                }
+                int grandparent = parent[p].load(std::memory_order_acquire);
+                if (p != grandparent) {
+                    parent[x].compare_exchange_weak(p, grandparent, std::memory_order_release,
+                                                    std::memory_order_relaxed);
+                }
+                x = grandparent;
+            }
+        }
+
+        void unite(int a, int b) {
+            while (true) {
+                a = find(a);
+                b = find(b);
+                if (a == b) {
+                    return;
+                }
+                if (a < b) {
+                    std::swap(a, b);
+                }
+                // link the bigger root under the smaller one, as long as it's still a root
+                int expected = a;
+                if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) {
+                    return;
+                }
+            }
+        }
+
+    private:
+        std::vector<std::atomic<int>> parent;
+    };
+
+    // numbers the clusters 0, 1, ... in order of their first point. roots[i] is the set point i is in, or -1 for noise
+    std::vector<int> numberClusters(const std::vector<int> &roots) {
+        std::vector<int> labels(roots.size(), DBscan::noiseLabel), numberOfRoot(roots.size(), -1);
+        int numClusters = 0;
+        for (std::size_t i = 0; i < roots.size(); ++i) {
+            if (roots[i] == -1) {
+                continue;
+            }
+            if (numberOfRoot[roots[i]] == -1) {
+                numberOfRoot[roots[i]] = numClusters++;
+            }
+            labels[i] = numberOfRoot[roots[i]];
+        }
+        return labels;
+    }
+
+    // DBscan::labels, for neighbors from anywhere
+    std::vector<int> parallelLabels(int n, int minPts, int numThreads, const NeighborCount &count,
+                                    const NeighborQuery &neighbors) {
+        INSTRUMENT_PHASE("dbscan.labels");
+        ThreadPool pool(numThreads);
+        // points are handed out in blocks, dense areas take much longer to query than sparse ones
+        const int blockSize = 256;
+        int numBlocks = (n + blockSize - 1) / blockSize;
+        std::vector<std::vector<int>> found(pool.size());
+
+        // pass 1: who's core. each thread only writes its own points
+        std::vector<char> core(n, 0);
+        pool.forEach(numBlocks, [&](std::size_t block, int worker) {
+            for (int i = block * blockSize; i < std::min(n, (int) (block + 1) * blockSize); ++i) {
+                core[i] = count(i, found[worker]) > minPts;
+            }
+        });
+
+        /*
+         * pass 2: every core point joins up with its core neighbors, and offers itself to its border neighbors,
+         * which keep the lowest offer. the neighbors get queried again rather than kept from pass 1, which would
+         * take memory proportional to the number of neighbor pairs (that's what NeighborGraph is for)
+         */
+        ConcurrentUnionFind sets(n);
+        std::vector<std::atomic<int>> borderOf(n);
+        for (std::atomic<int> &b : borderOf) {
+            b.store(n, std::memory_order_relaxed);
+        }
+        pool.forEach(numBlocks, [&](std::size_t block, int worker) {
+            for (int i = block * blockSize; i < std::min(n, (int) (block + 1) * blockSize); ++i) {
+                if (!core[i]) {
+                    continue;
+                }
+                neighbors(i, found[worker]);
+                for (int j : found[worker]) {
+                    if (core[j]) {
+                        if (j < i) { // the pair only has to be joined once
+                            sets.unite(i, j);
+                        }
+                    } else {
+                        int current = borderOf[j].load(std::memory_order_relaxed);
+                        while (i < current &&
+                               !borderOf[j].compare_exchange_weak(current, i, std::memory_order_relaxed)) {
+                        }
+                    }
+                }
+            }
+        });
+
+        std::vector<int> roots(n, -1);
+        pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int) {
+            for (std::size_t i = begin; i < end; ++i) {
+                if (core[i]) {
+                    roots[i] = sets.find(i);
+                } else if (borderOf[i].load(std::memory_order_relaxed) < n) {
+                    roots[i] = sets.find(borderOf[i].load(std::memory_order_relaxed));
+                }
+            }
+        });
+        INSTRUMENT_COUNT("dbscan.points", n);
+        INSTRUMENT_COUNT("dbscan.corePoints", std::count(core.begin(), core.end(), 1));
+        INSTRUMENT_COUNT("dbscan.noise", std::count(roots.begin(), roots.end(), -1));
+        return numberClusters(roots);
+    }
+}
+
+Point::Point(PointView pos_, int id_) {
     pos = pos_;
     id = id_;
 }
 
 
-DBscan::DBscan(double maxDist_, int minPts_) {
+DBscan::DBscan(double maxDist_, int minPts_, spatial::IndexType indexType_) {
     maxDist = maxDist_;
     minPts = minPts_;
+    indexType = indexType_;
 }
 
-std::vector<Cluster> DBscan::scan(std::vector<std::vector<double>> data) {
-    std::vector<Cluster> clusters;
-    // convert data2d to pts2d
-    std::vector<Point> points;
-    int id = 0;
-    for (std::vector<double> pos : data) {
-        points.push_back(Point(pos, id));
-        ++id;
+void DBscan::checkMaxDist() const {
+    // a zero radius would make the grid's cells (or a squared euclidean radius) degenerate, a negative one nan
+    if (!(maxDist > 0) || std::isinf(maxDist)) {
+        throw std::invalid_argument("DBscan: maxDist " + std::to_string(maxDist) + " has to be positive and finite");
     }
+}
 
-    // iterate through points and fill in params
-    for (Point outerPt : points) {
-        for (Point innerPt : points) {
-            if (outerPt.id != innerPt.id) {
-                if (dataGen::distance(outerPt.pos, innerPt.pos) < maxDist) {
-                    // "count" neighbors
-                    outerPt.neighbors.push_back(innerPt);
+template <typename Metric>
+std::vector<Cluster> DBscan::scan(DatasetView data) {
+    INSTRUMENT_PHASE("dbscan.scan");
+    std::vector<int> pointLabels = labels<Metric>(data);
+    int numClusters = 0;
+    for (int label : pointLabels) {
+        numClusters = std::max(numClusters, label + 1);
+    }
+    std::vector<Cluster> clusters(numClusters);
+    for (int id = 0; id < (int) data.size(); ++id) {
+        if (pointLabels[id] != noiseLabel) {
+            Point pt(data[id], id);
+            pt.noise = false;
+            clusters[pointLabels[id]].push_back(pt);
+        }
+    }
+    INSTRUMENT_COUNT("dbscan.clusters", clusters.size());
+#ifdef CS320_INSTRUMENT
+    // a loop the macro can't make disappear on its own
+    for (const Cluster &cluster : clusters) {
+        INSTRUMENT_RECORD("dbscan.clusterSize", cluster.size());
+    }
+#endif
+    return clusters;
+}
+
+template <typename Metric>
+std::vector<int> DBscan::labels(DatasetView data) {
+    checkMaxDist();
+    NeighborQuery neighbors = makeQuery<Metric>(data, maxDist, indexType);
+    return parallelLabels(data.size(), minPts, numThreads, countByQuery(neighbors), neighbors);
+}
+
+// for the metrics in metric.h
+template std::vector<Cluster> DBscan::scan<metric::Euclidean>(DatasetView);
+template std::vector<Cluster> DBscan::scan<metric::SquaredEuclidean>(DatasetView);
+template std::vector<Cluster> DBscan::scan<metric::Manhattan>(DatasetView);
+template std::vector<Cluster> DBscan::scan<metric::Cosine>(DatasetView);
+template std::vector<int> DBscan::labels<metric::Euclidean>(DatasetView);
+template std::vector<int> DBscan::labels<metric::SquaredEuclidean>(DatasetView);
+template std::vector<int> DBscan::labels<metric::Manhattan>(DatasetView);
+template std::vector<int> DBscan::labels<metric::Cosine>(DatasetView);
+
+std::vector<int> DBscan::labels(const spatial::NeighborGraph &graph) {
+    checkMaxDist();
+    if (maxDist > graph.radius()) {
+        throw std::invalid_argument("DBscan::labels: maxDist " + std::to_string(maxDist) +
+                                    " is bigger than the graph's radius " + std::to_string(graph.radius()));
+    }
+    double dist = maxDist;
+    NeighborQuery neighbors = [&graph, dist](int i, std::vector<int> &out) {
+        out.assign(graph.neighbors(i), graph.neighbors(i) + graph.count(i, dist));
+    };
+    NeighborCount count = [&graph, dist](int i, std::vector<int> &) { return graph.count(i, dist); };
+    return parallelLabels(graph.size(), minPts, numThreads, count, neighbors);
+}
+
+std::vector<int> DBscan::serialLabels(DatasetView data) {
+    checkMaxDist();
+    int n = data.size();
+    NeighborQuery neighbors = euclideanQuery(data, maxDist, indexType);
+    std::vector<int> found;
+    std::vector<char> core(n, 0);
+    for (int i = 0; i < n; ++i) {
+        neighbors(i, found);
+        core[i] = (int) found.size() > minPts;
+    }
+    // grow a cluster out from each core point nobody has reached yet. border points stick with whichever core
+    // point got to them first, then get moved to their lowest index core neighbor to match labels
+    std::vector<int> roots(n, -1);
+    std::deque<int> queue;
+    for (int start = 0; start < n; ++start) {
+        if (!core[start] || roots[start] != -1) {
+            continue;
+        }
+        roots[start] = start;
+        queue.push_back(start);
+        while (!queue.empty()) {
+            int pt = queue.front();
+            queue.pop_front();
+            neighbors(pt, found);
+            for (int j : found) {
+                if (roots[j] == -1) {
+                    roots[j] = start;
+                    if (core[j]) {
+                        queue.push_back(j);
+                    }
                 }
             }
-            // if there are enough neighbors, give new cluster label, otherwise label as noise
-            if (outerPt.neighbors.size() > minPts) {
-                clusters.push_back({outerPt});
-            } else {
-                outerPt.noise = true;
-            }
-
         }
     }
-    // the following should be a function given cluster that returns an updated version of cluster
-    for (Cluster cluster : clusters) {
-        for (Point corePt : cluster) {
-            // for each of this points neighbor points,
-            for (Point neighborPt : corePt.neighbors) {
-                // if the neighbor already has a label other than noise, move on to the next neighbor
-                // otherwise, give the neighbor the same new cluster label
-                if (neighborPt.noise) {
-                    cluster.push_back(neighborPt);
+    for (int i = 0; i < n; ++i) {
+        if (!core[i] && roots[i] != -1) {
+            neighbors(i, found);
+            int lowest = n;
+            for (int j : found) {
+                if (core[j]) {
+                    lowest = std::min(lowest, j);
                 }
-                // if the neighbor has more than the minimum number of neighbors, add all of them to the list of neighbors
-                // for this cluster, so that they go through this same loop... This should have been "covered" but might also result in too many clusters
             }
+            roots[i] = roots[lowest];
         }
     }
-    return clusters;
-}
\ No newline at end of file
+    return numberClusters(roots);
+}
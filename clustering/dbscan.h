@@ -1,21 +1,65 @@
+#pragma once
+
 #include <vector>
+#include "dataset.h"
+#include "metric.h"
+#include "neighborgraph.h"
+#include "spatial.h"
 
 class Point {
 public:
-    Point(std::vector<double> pos_, int id_);
-    std::vector<Point> neighbors; // pts within maxDist
-    std::vector<double> pos;
+    Point(PointView pos_, int id_);
+    std::vector<Point> neighbors; // pts within maxDist. scan doesn't fill this in anymore, labels has the answer
+    PointView pos; // points into the dataset passed to DBscan::scan, so that has to outlive the clusters
     bool noise = true;
     int id; // random identifier to differentiate points
 };
 
 typedef std::vector<Point> Cluster;
 
+/*
+ * a core point has more than minPts other points closer than maxDist. core points closer than maxDist to each
+ * other are in the same cluster, and so is any non core point closer than maxDist to one of them (a border
+ * point). everything else is noise.
+ * a border point near two clusters could go in either one. labels always puts it with its lowest index core
+ * neighbor, so the result doesn't depend on the thread count.
+ * scan and labels take the distance as a template parameter, one of the metric.h ones, with maxDist in its units
+ * (squared for metric::SquaredEuclidean). the spatial index finds candidates within Metric::euclideanRadius(maxDist)
+ * and the metric has the last word, except for metric::Cosine, which has no such radius and checks every pair
+ */
 class DBscan {
 public:
-    DBscan(double maxDist_, int minPts_);
-    std::vector<Cluster> scan(std::vector<std::vector<double>> data); // xy pairs of cluster c
+    static const int noiseLabel = -1;
+
+    // maxDist_ has to be positive and finite, with any metric and index. scan and labels throw
+    // std::invalid_argument otherwise
+    DBscan(double maxDist_, int minPts_, spatial::IndexType indexType_ = spatial::IndexType::Grid);
+
+    int numThreads = 0; // for labels, 0 = one per core
+
+    template <typename Metric = metric::Euclidean>
+    std::vector<Cluster> scan(DatasetView data); // points of each cluster
+    /*
+     * cluster of each point, numbered from 0 in order of each cluster's first point, or noiseLabel.
+     * finds core points in parallel, then merges neighboring core points' clusters in parallel through a lock free
+     * union find
+     */
+    template <typename Metric = metric::Euclidean>
+    std::vector<int> labels(DatasetView data);
+    /*
+     * same thing with the neighbors taken from a graph built for a radius >= maxDist (throws
+     * std::invalid_argument otherwise), euclidean only. build the graph once for the biggest maxDist of a parameter
+     * sweep and every DBscan in the sweep skips the neighbor search
+     */
+    std::vector<int> labels(const spatial::NeighborGraph &graph);
+    // the textbook one cluster at a time breadth first version, same labels. for checking labels
+    std::vector<int> serialLabels(DatasetView data);
+
 private:
+    void checkMaxDist() const;
+
     double maxDist;
     int minPts;
-};
\ No newline at end of file
+    // how neighbors get found. grid is best for 2d, and past UniformGrid::maxDims it's a kd tree anyway
+    spatial::IndexType indexType;
+};
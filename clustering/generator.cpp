@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include "columnar.h"
+#include "generator.h"
+#include "random.h"
+#include "threadpool.h"
+
+namespace {
+    // points per chunk for the writers
+    const std::size_t chunkRows = 1 << 16;
+}
+
+dataGen::Generator::Generator(std::size_t dims_, int numClusters_, std::uint64_t seed_) {
+    dims = dims_;
+    numClusters = numClusters_;
+    seed = seed_;
+}
+
+/*
+ * point i uses the counters [i * stride(), (i + 1) * stride()): the first says whether it's noise, the second picks
+ * its cluster and the rest are two per dimension (box muller needs two uniforms per normal). the centers come from
+ * a second seed made from the first
+ */
+int dataGen::Generator::label(std::size_t i) const {
+    std::uint64_t base = i * stride();
+    if (numClusters <= 0 || rng::uniform01(seed, base) < noise) {
+        return -1;
+    }
+    return rng::bits(seed, base + 1) % numClusters;
+}
+
+void dataGen::Generator::center(int cluster, double *out) const {
+    std::uint64_t centerSeed = rng::bits(seed, ~0ULL);
+    for (std::size_t d = 0; d < dims; ++d) {
+        out[d] = min + (max - min) * rng::uniform01(centerSeed, cluster * dims + d);
+    }
+}
+
+void dataGen::Generator::point(std::size_t i, double *out) const {
+    std::uint64_t base = i * stride() + 2;
+    int cluster = label(i);
+    if (cluster == -1) {
+        for (std::size_t d = 0; d < dims; ++d) {
+            out[d] = min + (max - min) * rng::uniform01(seed, base + 2 * d);
+        }
+        return;
+    }
+    center(cluster, out);
+    for (std::size_t d = 0; d < dims; ++d) {
+        double u1 = rng::uniform01(seed, base + 2 * d), u2 = rng::uniform01(seed, base + 2 * d + 1);
+        if (shape == Shape::Gaussian) {
+            // 1 - u1 is in (0, 1], so the log is finite
+            out[d] += spread * std::sqrt(-2 * std::log(1 - u1)) * std::cos(2 * M_PI * u2);
+        } else {
+            out[d] += spread * (2 * u1 - 1);
+        }
+    }
+}
+
+void dataGen::Generator::points(std::size_t begin, std::size_t end, double *out) const {
+    for (std::size_t i = begin; i < end; ++i) {
+        point(i, out + (i - begin) * dims);
+    }
+}
+
+Dataset dataGen::Generator::range(std::size_t begin, std::size_t end) const {
+    Dataset data(end - begin, dims);
+    points(begin, end, data.data());
+    return data;
+}
+
+Dataset dataGen::Generator::generate(std::size_t n, int numThreads) const {
+    Dataset data(n, dims);
+    ThreadPool pool(numThreads);
+    pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int) {
+        points(begin, end, data.data() + begin * dims);
+    });
+    return data;
+}
+
+/*
+ * a round of chunks (one per thread) gets made and formatted in parallel, then written in order while the
+ * buffers are reused for the next round. numbers are written with the shortest text that reads back exactly
+ */
+void dataGen::Generator::writeCSV(const std::string &path, std::size_t n, char sep, int numThreads) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("can't open " + path);
+    }
+    ThreadPool pool(numThreads);
+    // 24 characters is enough for any double, plus a separator
+    std::vector<std::vector<char>> text(pool.size(), std::vector<char>(chunkRows * dims * 25 + 1));
+    std::vector<std::size_t> lengths(pool.size());
+    std::vector<std::vector<double>> values(pool.size(), std::vector<double>(chunkRows * dims));
+    std::size_t numChunks = (n + chunkRows - 1) / chunkRows;
+    for (std::size_t first = 0; first < numChunks; first += pool.size()) {
+        std::size_t roundChunks = std::min<std::size_t>(pool.size(), numChunks - first);
+        pool.forEach(roundChunks, [&](std::size_t c, int) {
+            std::size_t begin = (first + c) * chunkRows, end = std::min(n, begin + chunkRows);
+            points(begin, end, values[c].data());
+            char *p = text[c].data(), *limit = p + text[c].size();
+            for (std::size_t i = 0; i < (end - begin) * dims; ++i) {
+                p = std::to_chars(p, limit, values[c][i]).ptr;
+                *p++ = (i + 1) % dims == 0 ? '\n' : sep;
+            }
+            lengths[c] = p - text[c].data();
+        });
+        for (std::size_t c = 0; c < roundChunks; ++c) {
+            out.write(text[c].data(), lengths[c]);
+        }
+    }
+    out.close();
+    if (!out) {
+        throw std::runtime_error("failed writing " + path);
+    }
+}
+
+void dataGen::Generator::writeColumnar(const std::string &path, std::size_t n, int numThreads) const {
+    columnar::Writer writer(path, n, dims);
+    ThreadPool pool(numThreads);
+    std::vector<std::vector<double>> values(pool.size(), std::vector<double>(chunkRows * dims));
+    pool.forEach((n + chunkRows - 1) / chunkRows, [&](std::size_t c, int worker) {
+        std::size_t begin = c * chunkRows, end = std::min(n, begin + chunkRows);
+        points(begin, end, values[worker].data());
+        writer.write(begin, DatasetView(values[worker].data(), end - begin, dims));
+    });
+    writer.close();
+}
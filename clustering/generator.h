@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "dataset.h"
+
+namespace dataGen {
+    /*
+     * seeded synthetic clusters in any number of dimensions, made with counter based random numbers (random.h):
+     * point i only depends on the seed and i, so any range of points can be made on its own, on any thread, and the
+     * same seed gives the same points whatever the thread count. that's what lets writeCSV and writeColumnar fill a
+     * file with billions of points in parallel chunks while only ever holding a few chunks in memory.
+     * every point is noise (uniform over the whole box) with probability noise, otherwise it's in one of the clusters,
+     * picked uniformly. the cluster centers are uniform in the box
+     */
+    class Generator {
+    public:
+        enum class Shape {
+            Gaussian, // normally distributed around the center, standard deviation spread in every dimension
+            Uniform // uniform in the cube spread either side of the center
+        };
+
+        Generator(std::size_t dims_, int numClusters_, std::uint64_t seed_);
+
+        std::size_t dims;
+        int numClusters;
+        std::uint64_t seed;
+        Shape shape = Shape::Gaussian;
+        double min = 0, max = 1000; // the box, the same in every dimension
+        double spread = 10;
+        double noise = 0;
+
+        int label(std::size_t i) const; // point i's cluster, -1 for noise
+        void center(int cluster, double *out) const; // out has room for dims values
+        void point(std::size_t i, double *out) const;
+        void points(std::size_t begin, std::size_t end, double *out) const; // row major
+
+        Dataset range(std::size_t begin, std::size_t end) const; // points [begin, end)
+        Dataset generate(std::size_t n, int numThreads = 0) const; // points [0, n), 0 threads = one per core
+
+        // points [0, n) straight to a file, formatted/converted in parallel chunks. throw std::runtime_error if the
+        // file can't be written
+        void writeCSV(const std::string &path, std::size_t n, char sep = ',', int numThreads = 0) const;
+        void writeColumnar(const std::string &path, std::size_t n, int numThreads = 0) const;
+
+    private:
+        std::uint64_t stride() const { return 2 * dims + 2; } // random numbers per point
+    };
+}
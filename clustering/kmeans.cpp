@@ -1,79 +1,1035 @@
+#include <algorithm>
 #include <vector>
 #include <cmath>
 #include <iostream>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include "kmeans.h"
+#include "columnar.h"
 #include "datagen.h"
+#include "instrument.h"
+#include "metric.h"
+#include "random.h"
+#include "simd.h"
+#include "threadpool.h"
 
-KMeans::KMeans(int numClusters_, double threshold_) {
+KMeans::KMeans(int numClusters_, double threshold_, Algorithm algorithm_) {
     numClusters = numClusters_;
     threshold = threshold_;
+    algorithm = algorithm_;
 }
 
-std::vector<std::vector<std::vector<double>>> KMeans::cluster(std::vector<std::vector<double>> data) {
-    std::srand(std::time(nullptr)); // current time = random seed
-    std::vector<std::vector<double>> centroids;
-    std::vector<std::vector<std::vector<double>>> clusters(numClusters);
+void KMeans::checkNumClusters() const {
+    if (numClusters < 1) {
+        throw std::invalid_argument("KMeans: numClusters is " + std::to_string(numClusters) +
+                                    ", it has to be at least 1");
+    }
+}
+
+template <typename Metric>
+std::vector<Dataset> KMeans::cluster(DatasetView data) {
+    KMeansResult result = fit<Metric>(data);
+    std::vector<Dataset> clusters;
+    std::vector<std::size_t> counts(numClusters);
+    for (int label : result.labels) {
+        ++counts[label];
+    }
+    for (int i = 0; i < numClusters; ++i) {
+        clusters.push_back(Dataset(0, data.dim()));
+        clusters[i].reserve(counts[i]);
+    }
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        clusters[result.labels[i]].push(data[i]);
+    }
+    return clusters;
+}
+
+namespace {
+    // the range of [0, n) that ThreadPool::parallelFor gives worker t
+    std::size_t rangeStart(std::size_t n, int t, int numThreads) {
+        return n * t / numThreads;
+    }
+
+    /*
+     * weighted D^2 sampling for k-means++: the first centroid is picked in proportion to weight, every next one in
+     * proportion to weight * squared distance to the closest centroid so far. serial, only used on the small
+     * candidate set k-means|| produces
+     */
+    Dataset weightedPlusPlus(DatasetView candidates, const std::vector<double> &weights, int k, std::mt19937_64 &gen) {
+        std::size_t m = candidates.size();
+        std::vector<double> minDist(m, 1.0);
+        Dataset centroids(0, candidates.dim());
+        centroids.reserve(k);
+        for (int c = 0; c < k; ++c) {
+            double total = 0;
+            for (std::size_t i = 0; i < m; ++i) {
+                total += weights[i] * minDist[i];
+            }
+            std::size_t pick = 0;
+            if (total > 0) {
+                double r = std::uniform_real_distribution<double>(0, total)(gen);
+                for (double sum = 0; pick < m - 1; ++pick) {
+                    sum += weights[pick] * minDist[pick];
+                    if (sum > r) {
+                        break;
+                    }
+                }
+            } else {
+                pick = std::uniform_int_distribution<std::size_t>(0, m - 1)(gen);
+            }
+            centroids.push(candidates[pick]);
+            for (std::size_t i = 0; i < m; ++i) {
+                double dist = dataGen::squaredDistance(candidates[i], candidates[pick]);
+                minDist[i] = c == 0 ? dist : std::min(minDist[i], dist);
+            }
+        }
+        return centroids;
+    }
+}
+
+Dataset KMeans::initialCentroids(DatasetView data) {
+    checkNumClusters();
+    INSTRUMENT_PHASE("kmeans.seed");
+    if (init == Init::KMeansPlusPlus) {
+        return plusPlusCentroids(data);
+    }
+    if (init == Init::KMeansParallel) {
+        return parallelCentroids(data);
+    }
+    return randomCentroids(data);
+}
+
+Dataset KMeans::randomCentroids(DatasetView data) {
+    std::mt19937_64 gen(seed);
+    std::size_t dims = data.dim();
+    Dataset centroids(numClusters, dims);
+    // find max and min of each dimension
+    std::vector<double> mins(data[0].begin(), data[0].end()), maxes(mins);
+    for (PointView pt : data) {
+        for (std::size_t d = 0; d < dims; ++d) {
+            mins[d] = std::min(mins[d], pt[d]);
+            maxes[d] = std::max(maxes[d], pt[d]);
+        }
+    }
+    // place random centroids in that box
     for (int i = 0; i < numClusters; ++i) {
-        // find max and min of x and y
-        double minX = data[0][0], minY = data[0][1], maxX = 0, maxY = 0;
-        for (std::vector<double> pt : data) {
-            if (pt[0] > maxX) {
-                maxX = pt[0];
+        for (std::size_t d = 0; d < dims; ++d) {
+            centroids.at(i, d) = std::uniform_real_distribution<double>(mins[d], maxes[d])(gen);
+        }
+    }
+    return centroids;
+}
+
+/*
+ * Arthur & Vassilvitskii, "k-means++: The Advantages of Careful Seeding" (2007). each new centroid is a data point
+ * picked with probability proportional to its squared distance to the closest centroid so far, which spreads them
+ * over the actual clusters. the distance updates are split across threads, each keeping the sum of its range so
+ * the pick only has to scan one range
+ */
+Dataset KMeans::plusPlusCentroids(DatasetView data) {
+    ThreadPool pool(numThreads);
+    std::mt19937_64 gen(seed);
+    std::size_t n = data.size();
+    std::vector<double> minDist(n, std::numeric_limits<double>::infinity()), partial(pool.size());
+    Dataset centroids(0, data.dim());
+    centroids.reserve(numClusters);
+    centroids.push(data[std::uniform_int_distribution<std::size_t>(0, n - 1)(gen)]);
+    for (int c = 1; c < numClusters; ++c) {
+        PointView last = centroids[c - 1];
+        pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int t) {
+            double sum = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                minDist[i] = std::min(minDist[i], dataGen::squaredDistance(data[i], last));
+                sum += minDist[i];
             }
-            if (pt[0] < minX) {
-                minX = pt[0];
+            partial[t] = sum;
+        });
+        double total = 0;
+        for (double sum : partial) {
+            total += sum;
+        }
+        if (total <= 0) {
+            // every point is already sitting on a centroid, any pick is as good as another
+            centroids.push(data[std::uniform_int_distribution<std::size_t>(0, n - 1)(gen)]);
+            continue;
+        }
+        double r = std::uniform_real_distribution<double>(0, total)(gen);
+        int t = 0;
+        while (t < pool.size() - 1 && r >= partial[t]) {
+            r -= partial[t];
+            ++t;
+        }
+        std::size_t pick = rangeStart(n, t, pool.size()), end = rangeStart(n, t + 1, pool.size());
+        for (double sum = minDist[pick]; sum <= r && pick + 1 < end; sum += minDist[pick]) {
+            ++pick;
+        }
+        centroids.push(data[std::min(pick, n - 1)]); // rounding can land past a range that's empty when n < threads
+    }
+    return centroids;
+}
+
+/*
+ * Bahmani et al., "Scalable K-Means++" (2012), aka k-means||. instead of k passes over the data it does a few
+ * rounds that each keep every point independently with probability oversample * d^2 / cost, then shrinks those
+ * candidates to k with weighted k-means++ (weight = how many points are closest to the candidate).
+ * each point's coin flip comes from hashing (seed, round, index), so the result doesn't depend on the thread count
+ */
+Dataset KMeans::parallelCentroids(DatasetView data) {
+    const int rounds = 5;
+    const double oversample = 2.0 * numClusters;
+    ThreadPool pool(numThreads);
+    std::mt19937_64 gen(seed);
+    std::size_t n = data.size(), dims = data.dim();
+    std::vector<double> minDist(n, std::numeric_limits<double>::infinity()), partial(pool.size());
+    std::vector<char> chosen(n, 0);
+    Dataset candidates(0, dims);
+    std::size_t first = std::uniform_int_distribution<std::size_t>(0, n - 1)(gen);
+    candidates.push(data[first]);
+    chosen[first] = 1;
+
+    std::size_t updatedUpTo = 0; // candidates before this are already folded into minDist
+    for (int round = 0; round <= rounds; ++round) {
+        std::size_t from = updatedUpTo, to = candidates.size();
+        pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int t) {
+            double sum = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                for (std::size_t c = from; c < to; ++c) {
+                    minDist[i] = std::min(minDist[i], dataGen::squaredDistance(data[i], candidates[c]));
+                }
+                sum += minDist[i];
             }
-            if (pt[1] > maxY) {
-                maxY = pt[1];
+            partial[t] = sum;
+        });
+        updatedUpTo = to;
+        double cost = 0;
+        for (double sum : partial) {
+            cost += sum;
+        }
+        if (round == rounds || cost <= 0) {
+            break;
+        }
+        pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int) {
+            for (std::size_t i = begin; i < end; ++i) {
+                if (!chosen[i] && rng::uniform01(seed + round + 1, i) < oversample * minDist[i] / cost) {
+                    chosen[i] = 2; // picked this round
+                }
+            }
+        });
+        for (std::size_t i = 0; i < n; ++i) {
+            if (chosen[i] == 2) {
+                chosen[i] = 1;
+                candidates.push(data[i]);
+            }
+        }
+    }
+
+    // weight each candidate by how many points are closest to it
+    std::size_t m = candidates.size();
+    std::vector<double> candidatesT(m * dims);
+    for (std::size_t c = 0; c < m; ++c) {
+        for (std::size_t d = 0; d < dims; ++d) {
+            candidatesT[d * m + c] = candidates.at(c, d);
+        }
+    }
+    std::vector<std::vector<double>> threadWeights(pool.size(), std::vector<double>(m, 0.0));
+    pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int t) {
+        std::vector<double> scratch(m);
+        double dist;
+        for (std::size_t i = begin; i < end; ++i) {
+            ++threadWeights[t][simd::nearest(data[i].data(), candidatesT.data(), m, dims, scratch.data(), dist)];
+        }
+    });
+    std::vector<double> weights(m, 0.0);
+    for (const std::vector<double> &w : threadWeights) {
+        for (std::size_t c = 0; c < m; ++c) {
+            weights[c] += w[c];
+        }
+    }
+    if ((int) m <= numClusters) {
+        // not enough candidates (tiny or very repetitive data), top up with k-means++ picks carrying on from
+        // minDist. points already picked are at distance 0, so they can't come up again
+        Dataset centroids = std::move(candidates);
+        while ((int) centroids.size() < numClusters) {
+            double total = 0;
+            for (double dist : minDist) {
+                total += dist;
             }
-            if (pt[1] < minY) {
-                minY = pt[1];
+            std::size_t pick = n;
+            if (total > 0) {
+                double r = std::uniform_real_distribution<double>(0, total)(gen);
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (minDist[i] > 0) {
+                        pick = i; // the last point with any weight, in case rounding runs r past the end
+                        if (r < minDist[i]) {
+                            break;
+                        }
+                        r -= minDist[i];
+                    }
+                }
+            } else {
+                // fewer distinct points than clusters, so some centroids have to repeat. at least use each point once
+                pick = std::find(chosen.begin(), chosen.end(), 0) - chosen.begin();
+                if (pick == n) {
+                    pick = std::uniform_int_distribution<std::size_t>(0, n - 1)(gen);
+                }
             }
+            chosen[pick] = 1;
+            centroids.push(data[pick]);
+            PointView last = centroids[centroids.size() - 1];
+            pool.parallelFor(n, [&](std::size_t begin, std::size_t end, int) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    minDist[i] = std::min(minDist[i], dataGen::squaredDistance(data[i], last));
+                }
+            });
         }
-        // place random centroid
-        centroids.push_back({dataGen::scaleBetween(std::rand(), minX, maxX, 0, RAND_MAX),
-                             dataGen::scaleBetween(std::rand(), minY, maxY, 0, RAND_MAX)});
+        return centroids;
+    }
+    return weightedPlusPlus(candidates, weights, numClusters, gen);
+}
+
+namespace {
+    // what centroid motion (and the bounds in Elkan and Hamerly) is measured in
+    template <typename Metric>
+    using Movement = typename std::conditional<std::is_void<typename Metric::Triangle>::value, Metric,
+                                               typename Metric::Triangle>::type;
+
+    // squared euclidean and euclidean pick the same closest centroid, which the simd kernels can find
+    template <typename Metric>
+    constexpr bool euclideanOrder = std::is_same<typename Metric::Triangle, metric::Euclidean>::value;
+
+    // how much a point counts towards its centroid. 1 / its length for Center::Direction, so the sums add up unit
+    // vectors (points at the origin have no direction and count for nothing)
+    template <typename Metric, std::size_t D>
+    double weight(const double *pt, std::size_t dims) {
+        if constexpr (Metric::center == metric::Center::Direction) {
+            double norm = 0;
+            metric::forDims<D>(dims, [&](std::size_t d) { norm += pt[d] * pt[d]; });
+            return norm > 0 ? 1 / std::sqrt(norm) : 0;
+        } else {
+            return 1;
+        }
+    }
+
+    // index of the closest centroid (first one on ties), for metrics the simd kernels don't do
+    template <typename Metric, std::size_t D>
+    int nearest(const double *pt, const Dataset &centroids, std::size_t dims) {
+        int best = 0;
+        double bestDist = std::numeric_limits<double>::infinity();
+        for (std::size_t j = 0; j < centroids.size(); ++j) {
+            double dist = Metric::template distance<D>(pt, centroids[j].data(), dims);
+            if (dist < bestDist) {
+                bestDist = dist;
+                best = j;
+            }
+        }
+        return best;
+    }
+}
+
+template <typename Metric>
+KMeansResult KMeans::fit(DatasetView data) {
+    if (data.empty()) {
+        return fit<Metric>(data, Dataset(0, data.dim()));
+    }
+    return fit<Metric>(data, initialCentroids(data));
+}
+
+template <typename Metric>
+KMeansResult KMeans::fit(DatasetView data, Dataset initialCentroids) {
+    checkNumClusters();
+    INSTRUMENT_PHASE("kmeans.fit");
+    KMeansResult result;
+    result.centroids = std::move(initialCentroids);
+    result.labels.assign(data.size(), 0);
+    if (data.empty()) {
+        return result;
+    }
+    // the kernels index the centroids by label and dimension without checking
+    if ((int) result.centroids.size() != numClusters || result.centroids.dim() != data.dim()) {
+        throw std::invalid_argument("KMeans::fit: " + std::to_string(result.centroids.size()) +
+                                    " starting centroids with " + std::to_string(result.centroids.dim()) +
+                                    " dimensions, expected " + std::to_string(numClusters) + " with " +
+                                    std::to_string(data.dim()));
+    }
+    metric::withDims(data.dim(), [&](auto dimsConstant) {
+        const std::size_t D = decltype(dimsConstant)::value;
+        std::size_t dims = data.dim();
+        if constexpr (!std::is_void<typename Metric::Triangle>::value) {
+            if (algorithm == Algorithm::Elkan) {
+                elkan<Metric, D>(data, result);
+            } else if (algorithm == Algorithm::Hamerly) {
+                hamerly<Metric, D>(data, result);
+            } else {
+                lloyd<Metric, D>(data, result);
+            }
+        } else {
+            lloyd<Metric, D>(data, result);
+        }
+        result.inertia = 0;
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            result.inertia += Metric::template distance<D>(data[i].data(),
+                                                           result.centroids[result.labels[i]].data(), dims);
+        }
+    });
+    INSTRUMENT_COUNT("kmeans.points", data.size());
+    INSTRUMENT_COUNT("kmeans.distances", result.distanceEvals);
+    INSTRUMENT_RECORD("kmeans.iterations", result.iterations);
+    return result;
+}
+
+template <typename Metric, std::size_t D>
+double KMeans::updateCentroids(DatasetView data, KMeansResult &result, std::vector<double> &motion) {
+    std::size_t n = data.size(), dims = data.dim();
+    std::vector<double> positions(numClusters * dims, 0.0);
+    std::vector<long> counts(numClusters, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        ++counts[result.labels[i]];
+    }
+    if constexpr (Metric::center == metric::Center::Median) {
+        // every cluster's points next to each other, then the median of each dimension
+        std::vector<std::size_t> starts(numClusters + 1, 0), members(n);
+        for (int j = 0; j < numClusters; ++j) {
+            starts[j + 1] = starts[j] + counts[j];
+        }
+        std::vector<std::size_t> next(starts.begin(), starts.end() - 1);
+        for (std::size_t i = 0; i < n; ++i) {
+            members[next[result.labels[i]]++] = i;
+        }
+        std::vector<double> values;
+        for (int j = 0; j < numClusters; ++j) {
+            for (std::size_t d = 0; d < dims && counts[j] > 0; ++d) {
+                values.clear();
+                for (std::size_t m = starts[j]; m < starts[j + 1]; ++m) {
+                    values.push_back(data[members[m]][d]);
+                }
+                auto middle = values.begin() + values.size() / 2;
+                std::nth_element(values.begin(), middle, values.end());
+                positions[j * dims + d] = *middle;
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < n; ++i) {
+            const double *pt = data[i].data();
+            double *sum = &positions[result.labels[i] * dims];
+            double w = weight<Metric, D>(pt, dims);
+            for (std::size_t d = 0; d < dims; ++d) {
+                sum[d] += w * pt[d];
+            }
+        }
+        for (int j = 0; j < numClusters; ++j) {
+            for (std::size_t d = 0; d < dims && counts[j] > 0; ++d) {
+                positions[j * dims + d] /= counts[j];
+            }
+        }
+    }
+    return moveCentroids<Metric, D>(positions, counts, result, motion);
+}
+
+template <typename Metric, std::size_t D>
+double KMeans::moveCentroids(const std::vector<double> &positions, const std::vector<long> &counts,
+                             KMeansResult &result, std::vector<double> &motion) {
+    std::size_t dims = result.centroids.dim();
+    std::vector<double> oldPos(dims);
+    double total = 0;
+    for (int i = 0; i < numClusters; ++i) {
+        // an empty cluster has no center, so its centroid just stays put
+        if (counts[i] == 0) {
+            motion[i] = 0;
+        } else {
+            for (std::size_t d = 0; d < dims; ++d) {
+                oldPos[d] = result.centroids.at(i, d);
+                result.centroids.at(i, d) = positions[i * dims + d];
+            }
+            motion[i] = Movement<Metric>::template distance<D>(oldPos.data(), result.centroids.row(i), dims);
+        }
+        total += motion[i];
+    }
+    double avg = total / (double) numClusters;
+    INSTRUMENT_RECORD("kmeans.movement", avg);
+    INSTRUMENT_EVENT("kmeans.movement", avg);
+    if (verbose) {
+        // one write per iteration, and no flush: std::endl for every centroid used to be most of the time for small k
+        std::ostringstream report;
+        for (int i = 0; i < numClusters; ++i) {
+            report << "i: " << i << ": " << motion[i] << "\n";
+        }
+        report << "avg: " << avg << "\n";
+        std::cout << report.str();
+    }
+    return avg;
+}
+
+/*
+ * the points are split between numThreads threads. each one finds the closest centroid for its points (with the
+ * simd kernel for euclidean metrics) and adds them into its own sums and counts, which get added together after
+ * every iteration, so nothing is shared (or locked) while assigning. medians can't be added up like that, so those
+ * get worked out after assigning
+ */
+template <typename Metric, std::size_t D>
+void KMeans::lloyd(DatasetView data, KMeansResult &result) {
+    const bool sumsPerThread = Metric::center != metric::Center::Median;
+    ThreadPool pool(numThreads);
+    std::size_t dims = data.dim(), k = numClusters;
+    std::vector<double> centroidsT(dims * k), motion(k), sums(k * dims);
+    std::vector<long> counts(k);
+    std::vector<std::vector<double>> threadSums(pool.size()), scratch(pool.size());
+    std::vector<std::vector<long>> threadCounts(pool.size());
+    for (int t = 0; t < pool.size(); ++t) {
+        scratch[t].resize(k);
     }
-    std::vector<double> motion(numClusters);
-    // how far each centroid is moving. centroid should probably be a custom datatype
 
     // repeat until centroids are moving less than threshold distance
     double avg = threshold + 1;
-    while (avg > threshold) {
-       // clusters.clear(); TODO: shouldn't this be cleared each time, because otherwise points will be in multiple clusters?
-        for (std::vector<double> pt : data) {
-            // find which centroid it is closest to.
-            int index = 0;
-            double dist = dataGen::distance(centroids[0], pt);
-            for (int i = 0; i < centroids.size(); ++i) {
-                std::vector<double> centroid = centroids[i];
-                if (dataGen::distance(centroid, pt) < dist) {
-                    index = i;
-                }
-            }
-            // move to that index of clusters
-            clusters[index].push_back(pt);
-        }
-        // recompute centroids
-        for (int i = 0; i < centroids.size(); ++i) {
-            double x = 0, y = 0;
-            for (std::vector<double> pt : clusters[i]) {
-                x += pt[0];
-                y += pt[1];
-            }
-            std::vector<double> oldPos = centroids[i];
-            centroids[i] = {x / clusters[i].size(), y / clusters[i].size()};
-            motion[i] = dataGen::distance(oldPos, centroids[i]);
-            std::cout << "i: " << i << ": " << motion[i] << std::endl;
-        }
-        // set the average
-        double sum = 0;
-        for (double dist : motion) {
-            sum += dist;
-        }
-        avg = sum / (double) numClusters;
-        std::cout << "avg: " << avg << std::endl;
+    while (avg > threshold && result.iterations < maxIterations) {
+        INSTRUMENT_PHASE("kmeans.iteration");
+        for (std::size_t j = 0; j < k; ++j) {
+            for (std::size_t d = 0; d < dims; ++d) {
+                centroidsT[d * k + j] = result.centroids.at(j, d);
+            }
+        }
+        pool.parallelFor(data.size(), [&](std::size_t begin, std::size_t end, int t) {
+            std::vector<double> &mySums = threadSums[t];
+            std::vector<long> &myCounts = threadCounts[t];
+            mySums.assign(k * dims, 0.0);
+            myCounts.assign(k, 0);
+            double dist;
+            for (std::size_t i = begin; i < end; ++i) {
+                // find which centroid it is closest to
+                const double *pt = data[i].data();
+                int index;
+                if constexpr (euclideanOrder<Metric>) {
+                    index = simd::nearest(pt, centroidsT.data(), k, dims, scratch[t].data(), dist);
+                } else {
+                    index = nearest<Metric, D>(pt, result.centroids, dims);
+                }
+                result.labels[i] = index;
+                if constexpr (sumsPerThread) {
+                    double w = weight<Metric, D>(pt, dims);
+                    for (std::size_t d = 0; d < dims; ++d) {
+                        mySums[index * dims + d] += w * pt[d];
+                    }
+                    ++myCounts[index];
+                }
+            }
+        });
+        result.distanceEvals += (long) data.size() * numClusters;
+        if constexpr (sumsPerThread) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            std::fill(counts.begin(), counts.end(), 0);
+            for (int t = 0; t < pool.size(); ++t) {
+                for (std::size_t j = 0; j < k * dims; ++j) {
+                    sums[j] += threadSums[t][j];
+                }
+                for (std::size_t j = 0; j < k; ++j) {
+                    counts[j] += threadCounts[t][j];
+                }
+            }
+            for (std::size_t j = 0; j < k * dims; ++j) {
+                if (counts[j / dims] > 0) {
+                    sums[j] /= counts[j / dims];
+                }
+            }
+            avg = moveCentroids<Metric, D>(sums, counts, result, motion);
+        } else {
+            avg = updateCentroids<Metric, D>(data, result, motion);
+        }
+        ++result.iterations;
+    }
+}
+
+/*
+ * Elkan, "Using the Triangle Inequality to Accelerate k-Means" (2003). distances are Metric::Triangle's.
+ * upper[i] >= distance from point i to its centroid, lower[i * k + j] <= distance from point i to centroid j.
+ * if upper is below half the distance between the point's centroid and centroid j (or below lower for j),
+ * centroid j can't be closer, so its distance is never computed
+ */
+template <typename Metric, std::size_t D>
+void KMeans::elkan(DatasetView data, KMeansResult &result) {
+    std::size_t n = data.size(), dims = data.dim();
+    int k = numClusters;
+    Dataset &centroids = result.centroids;
+    std::vector<int> &labels = result.labels;
+    std::vector<double> upper(n), lower(n * k), motion(k);
+    std::vector<double> centroidDist(k * k), halfNearest(k); // halfNearest[j] = half distance to j's closest centroid
+    std::vector<char> stale(n, 0); // upper[i] might be loose and needs recomputing before it's trusted
+    auto distance = [dims](PointView a, PointView b) {
+        return Metric::Triangle::template distance<D>(a.data(), b.data(), dims);
+    };
+
+    auto computeCentroidDists = [&]() {
+        for (int a = 0; a < k; ++a) {
+            halfNearest[a] = std::numeric_limits<double>::infinity();
+            for (int b = 0; b < k; ++b) {
+                centroidDist[a * k + b] = a == b ? 0 : distance(centroids[a], centroids[b]);
+                if (a != b) {
+                    halfNearest[a] = std::min(halfNearest[a], 0.5 * centroidDist[a * k + b]);
+                }
+            }
+        }
+    };
+
+    // first assignment is a full scan that fills in exact bounds
+    for (std::size_t i = 0; i < n; ++i) {
+        double *low = &lower[i * k];
+        int index = 0;
+        for (int j = 0; j < k; ++j) {
+            low[j] = distance(data[i], centroids[j]);
+            if (low[j] < low[index]) {
+                index = j;
+            }
+        }
+        labels[i] = index;
+        upper[i] = low[index];
+    }
+    result.distanceEvals += (long) n * k;
+    double avg = updateCentroids<Metric, D>(data, result, motion);
+    ++result.iterations;
+
+    while (avg > threshold && result.iterations < maxIterations) {
+        INSTRUMENT_PHASE("kmeans.iteration");
+        // the centroids moved, so loosen the bounds by how far they went
+        for (std::size_t i = 0; i < n; ++i) {
+            double *low = &lower[i * k];
+            for (int j = 0; j < k; ++j) {
+                low[j] = std::max(low[j] - motion[j], 0.0);
+            }
+            upper[i] += motion[labels[i]];
+            stale[i] = 1;
+        }
+        computeCentroidDists();
+        result.distanceEvals += (long) k * (k - 1);
 
+        for (std::size_t i = 0; i < n; ++i) {
+            int a = labels[i];
+            if (upper[i] <= halfNearest[a]) {
+                continue; // nothing else can be closer
+            }
+            double *low = &lower[i * k];
+            for (int j = 0; j < k; ++j) {
+                if (j == a || upper[i] <= low[j] || upper[i] <= 0.5 * centroidDist[a * k + j]) {
+                    continue;
+                }
+                if (stale[i]) {
+                    upper[i] = distance(data[i], centroids[a]);
+                    low[a] = upper[i];
+                    stale[i] = 0;
+                    ++result.distanceEvals;
+                    if (upper[i] <= low[j] || upper[i] <= 0.5 * centroidDist[a * k + j]) {
+                        continue;
+                    }
+                }
+                double dist = distance(data[i], centroids[j]);
+                low[j] = dist;
+                ++result.distanceEvals;
+                if (dist < upper[i] || (dist == upper[i] && j < a)) {
+                    a = j;
+                    upper[i] = dist;
+                }
+            }
+            labels[i] = a;
+        }
+        avg = updateCentroids<Metric, D>(data, result, motion);
+        ++result.iterations;
     }
-    return clusters;
-}
\ No newline at end of file
+}
+
+/*
+ * Hamerly, "Making k-means even faster" (2010). same idea as Elkan, but only one lower bound per point: the
+ * distance to the second closest centroid
+ */
+template <typename Metric, std::size_t D>
+void KMeans::hamerly(DatasetView data, KMeansResult &result) {
+    std::size_t n = data.size(), dims = data.dim();
+    int k = numClusters;
+    Dataset &centroids = result.centroids;
+    std::vector<int> &labels = result.labels;
+    std::vector<double> upper(n), lower(n), motion(k), halfNearest(k);
+    auto distance = [dims](PointView a, PointView b) {
+        return Metric::Triangle::template distance<D>(a.data(), b.data(), dims);
+    };
+
+    // finds the closest and second closest centroid from scratch
+    auto fullScan = [&](std::size_t i) {
+        int index = 0;
+        double best = std::numeric_limits<double>::infinity(), second = best;
+        for (int j = 0; j < k; ++j) {
+            double dist = distance(data[i], centroids[j]);
+            if (dist < best) {
+                second = best;
+                best = dist;
+                index = j;
+            } else if (dist < second) {
+                second = dist;
+            }
+        }
+        labels[i] = index;
+        upper[i] = best;
+        lower[i] = second;
+        result.distanceEvals += k;
+    };
+
+    for (std::size_t i = 0; i < n; ++i) {
+        fullScan(i);
+    }
+    double avg = updateCentroids<Metric, D>(data, result, motion);
+    ++result.iterations;
+
+    while (avg > threshold && result.iterations < maxIterations) {
+        INSTRUMENT_PHASE("kmeans.iteration");
+        // loosen the bounds. the lower bound drops by the most any other centroid moved
+        int fastest = 0;
+        for (int j = 1; j < k; ++j) {
+            if (motion[j] > motion[fastest]) {
+                fastest = j;
+            }
+        }
+        double fastestOther = 0;
+        for (int j = 0; j < k; ++j) {
+            if (j != fastest) {
+                fastestOther = std::max(fastestOther, motion[j]);
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            upper[i] += motion[labels[i]];
+            lower[i] -= labels[i] == fastest ? fastestOther : motion[fastest];
+        }
+        for (int a = 0; a < k; ++a) {
+            halfNearest[a] = std::numeric_limits<double>::infinity();
+            for (int b = 0; b < k; ++b) {
+                if (a != b) {
+                    halfNearest[a] = std::min(halfNearest[a], 0.5 * distance(centroids[a], centroids[b]));
+                }
+            }
+        }
+        result.distanceEvals += (long) k * (k - 1);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            double bound = std::max(halfNearest[labels[i]], lower[i]);
+            if (upper[i] <= bound) {
+                continue;
+            }
+            // tighten the upper bound and try again before doing the full scan
+            upper[i] = distance(data[i], centroids[labels[i]]);
+            ++result.distanceEvals;
+            if (upper[i] <= bound) {
+                continue;
+            }
+            fullScan(i);
+        }
+        avg = updateCentroids<Metric, D>(data, result, motion);
+        ++result.iterations;
+    }
+}
+
+// for the metrics in metric.h
+template std::vector<Dataset> KMeans::cluster<metric::SquaredEuclidean>(DatasetView);
+template std::vector<Dataset> KMeans::cluster<metric::Euclidean>(DatasetView);
+template std::vector<Dataset> KMeans::cluster<metric::Manhattan>(DatasetView);
+template std::vector<Dataset> KMeans::cluster<metric::Cosine>(DatasetView);
+template KMeansResult KMeans::fit<metric::SquaredEuclidean>(DatasetView);
+template KMeansResult KMeans::fit<metric::Euclidean>(DatasetView);
+template KMeansResult KMeans::fit<metric::Manhattan>(DatasetView);
+template KMeansResult KMeans::fit<metric::Cosine>(DatasetView);
+template KMeansResult KMeans::fit<metric::SquaredEuclidean>(DatasetView, Dataset);
+template KMeansResult KMeans::fit<metric::Euclidean>(DatasetView, Dataset);
+template KMeansResult KMeans::fit<metric::Manhattan>(DatasetView, Dataset);
+template KMeansResult KMeans::fit<metric::Cosine>(DatasetView, Dataset);
+
+MiniBatchKMeans::MiniBatchKMeans(int numClusters_, std::size_t batchSize_) {
+    numClusters = numClusters_;
+    batchSize = batchSize_;
+}
+
+namespace {
+    void transpose(DatasetView centroids, std::vector<double> &centroidsT) {
+        std::size_t k = centroids.size(), dims = centroids.dim();
+        centroidsT.resize(k * dims);
+        for (std::size_t j = 0; j < k; ++j) {
+            for (std::size_t d = 0; d < dims; ++d) {
+                centroidsT[d * k + j] = centroids[j][d];
+            }
+        }
+    }
+}
+
+Dataset MiniBatchKMeans::fit(BatchReader &reader) {
+    std::size_t k = numClusters, dims = reader.dim();
+    // starting centroids: k different random points from the beginning of the input
+    Dataset batch, first;
+    reader.rewind();
+    reader.next(first, std::max(batchSize, k));
+    if (first.size() < k) {
+        throw std::invalid_argument("MiniBatchKMeans::fit: need at least " + std::to_string(k) + " points");
+    }
+    std::vector<std::size_t> picks(first.size());
+    for (std::size_t i = 0; i < picks.size(); ++i) {
+        picks[i] = i;
+    }
+    std::mt19937_64 gen(seed);
+    std::shuffle(picks.begin(), picks.end(), gen);
+    Dataset centroids(0, dims);
+    centroids.reserve(k);
+    for (std::size_t j = 0; j < k; ++j) {
+        centroids.push(first[picks[j]]);
+    }
+    first = Dataset(); // don't hang on to it for the whole fit
+
+    std::vector<long> seen(k, 0);
+    std::vector<int> labels(batchSize);
+    std::vector<double> centroidsT, scratch(k);
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        reader.rewind();
+        while (reader.next(batch, batchSize)) {
+            // assign the whole batch against the same centroids, then move them
+            transpose(centroids, centroidsT);
+            double dist;
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                labels[i] = simd::nearest(batch[i].data(), centroidsT.data(), k, dims, scratch.data(), dist);
+            }
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                double *c = centroids.row(labels[i]);
+                double rate = 1.0 / ++seen[labels[i]];
+                for (std::size_t d = 0; d < dims; ++d) {
+                    c[d] += rate * (batch[i][d] - c[d]);
+                }
+            }
+        }
+    }
+    return centroids;
+}
+
+long MiniBatchKMeans::assign(BatchReader &reader, DatasetView centroids, const std::string &labelFile) {
+    std::ofstream out(labelFile, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("can't open " + labelFile);
+    }
+    std::size_t k = centroids.size(), dims = centroids.dim();
+    std::vector<double> centroidsT, scratch(k);
+    transpose(centroids, centroidsT);
+    // labels are formatted into one buffer per batch so the stream only sees big writes
+    std::vector<char> text(batchSize * 12);
+    Dataset batch;
+    long total = 0;
+    reader.rewind();
+    while (reader.next(batch, batchSize)) {
+        char *p = text.data();
+        double dist;
+        for (PointView pt : batch) {
+            int label = simd::nearest(pt.data(), centroidsT.data(), k, dims, scratch.data(), dist);
+            p = std::to_chars(p, text.data() + text.size(), label).ptr;
+            *p++ = '\n';
+        }
+        out.write(text.data(), p - text.data());
+        total += batch.size();
+    }
+    if (!out) {
+        throw std::runtime_error("failed writing " + labelFile);
+    }
+    return total;
+}
+
+KMeansSearch::KMeansSearch(int minK_, int maxK_, int restarts_) {
+    minK = minK_;
+    maxK = maxK_;
+    restarts = restarts_;
+}
+
+std::vector<KMeansResult> KMeansSearch::run(DatasetView data) {
+    if (restarts < 1 || minK < 1 || minK > maxK) {
+        throw std::invalid_argument("KMeansSearch::run: needs restarts >= 1 and 1 <= minK <= maxK, got restarts " +
+                                    std::to_string(restarts) + ", k from " + std::to_string(minK) + " to " +
+                                    std::to_string(maxK));
+    }
+    int numK = maxK - minK + 1;
+    std::vector<KMeansResult> runs(numK * restarts);
+    ThreadPool pool(numThreads);
+    // every (k, restart) pair is its own single threaded job, handed out to whichever thread is free
+    pool.forEach(runs.size(), [&](std::size_t job, int) {
+        int k = minK + job / restarts, restart = job % restarts;
+        KMeans clusterer(k, threshold, algorithm);
+        clusterer.init = init;
+        clusterer.verbose = false;
+        clusterer.maxIterations = maxIterations;
+        clusterer.seed = rng::bits(seed, ((std::uint64_t) k << 32) | restart);
+        runs[job] = clusterer.fit(data);
+    });
+    // lowest inertia wins, ties go to the earlier restart so the answer doesn't depend on timing
+    std::vector<KMeansResult> best;
+    for (int i = 0; i < numK; ++i) {
+        int winner = i * restarts;
+        for (int r = 1; r < restarts; ++r) {
+            if (runs[i * restarts + r].inertia < runs[winner].inertia) {
+                winner = i * restarts + r;
+            }
+        }
+        best.push_back(std::move(runs[winner]));
+    }
+    return best;
+}
+
+int KMeansSearch::pickK(const std::vector<KMeansResult> &best) const {
+    for (std::size_t i = 0; i + 1 < best.size(); ++i) {
+        if (best[i].inertia <= 0 || best[i + 1].inertia > best[i].inertia * (1 - elbow)) {
+            return minK + i;
+        }
+    }
+    return maxK;
+}
+
+KMeansModel KMeans::fitModel(DatasetView data) {
+    return KMeansModel(fit<metric::SquaredEuclidean>(data));
+}
+
+KMeansModel::KMeansModel(Dataset centroids_, Index index_)
+        : KMeansModel(std::move(centroids_), std::vector<long>(), index_) {}
+
+namespace {
+    std::vector<long> labelCounts(const KMeansResult &result) {
+        std::vector<long> counts(result.centroids.size(), 0);
+        for (int label : result.labels) {
+            ++counts[label];
+        }
+        return counts;
+    }
+}
+
+KMeansModel::KMeansModel(const KMeansResult &result, Index index_)
+        : KMeansModel(result.centroids.clone(), labelCounts(result), index_) {}
+
+KMeansModel::KMeansModel(Dataset centroids_, std::vector<long> counts_, Index index_)
+        : centroidData(std::move(centroids_)), pointCounts(std::move(counts_)), index(index_) {
+    if (centroidData.layout() != Layout::RowMajor) {
+        centroidData = centroidData.toLayout(Layout::RowMajor);
+    }
+    pointCounts.resize(size(), 0); // none given = all 0
+    sums.resize(size() * dim());
+    for (std::size_t j = 0; j < size(); ++j) {
+        for (std::size_t d = 0; d < dim(); ++d) {
+            sums[j * dim() + d] = centroidData.at(j, d) * pointCounts[j];
+        }
+    }
+    rebuildIndex();
+}
+
+/*
+ * a KDTree only pays off when there are enough centroids for it to skip most of them, and in few enough dimensions
+ * that its splitting planes actually cut anything off. in bench "kmeans-model" it's 2-15x faster than the scan for
+ * k >= 256 in 2d, but with points between clusters it's already 4x slower in 8d, so Auto only uses it for up to 4
+ */
+void KMeansModel::rebuildIndex() {
+    transpose(centroidData, centroidsT);
+    bool useTree = index == Index::KDTree || (index == Index::Auto && size() >= 64 && dim() <= 4);
+    if (useTree && size() > 0) {
+        tree.emplace(centroidData, 4);
+    } else {
+        tree.reset();
+    }
+}
+
+void KMeansModel::check(std::size_t pointDims) const {
+    if (pointDims != dim()) {
+        throw std::invalid_argument("KMeansModel: points have " + std::to_string(pointDims) +
+                                    " dimensions, the centroids have " + std::to_string(dim()));
+    }
+    if (size() == 0) {
+        throw std::logic_error("KMeansModel: no centroids to assign points to");
+    }
+}
+
+int KMeansModel::nearest(const double *point) const {
+    if (tree) {
+        return tree->closest(point).index;
+    }
+    thread_local std::vector<double> scratch;
+    scratch.resize(size());
+    double dist;
+    return simd::nearest(point, centroidsT.data(), size(), dim(), scratch.data(), dist);
+}
+
+int KMeansModel::assign(PointView point) const {
+    check(point.size());
+    return nearest(point.data());
+}
+
+void KMeansModel::assignBatch(DatasetView points, int *labels, int numThreads) const {
+    check(points.dim());
+    INSTRUMENT_COUNT("kmeans.model.assigned", points.size());
+    auto assignRange = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            labels[i] = nearest(points[i].data());
+        }
+    };
+    if (numThreads == 1 || points.size() < 1024) {
+        assignRange(0, points.size()); // a thread pool costs more than this takes
+        return;
+    }
+    ThreadPool pool(numThreads);
+    pool.parallelFor(points.size(), [&](std::size_t begin, std::size_t end, int) { assignRange(begin, end); });
+}
+
+std::vector<int> KMeansModel::assignBatch(DatasetView points, int numThreads) const {
+    std::vector<int> labels(points.size());
+    assignBatch(points, labels.data(), numThreads);
+    return labels;
+}
+
+std::vector<int> KMeansModel::update(DatasetView points, int numThreads) {
+    INSTRUMENT_PHASE("kmeans.model.update");
+    std::vector<int> labels = assignBatch(points, numThreads);
+    std::size_t dims = dim();
+    std::vector<char> moved(size(), 0);
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        double *sum = &sums[labels[i] * dims];
+        for (std::size_t d = 0; d < dims; ++d) {
+            sum[d] += points[i][d];
+        }
+        ++pointCounts[labels[i]];
+        moved[labels[i]] = 1;
+    }
+    for (std::size_t j = 0; j < size(); ++j) {
+        for (std::size_t d = 0; d < dims && moved[j]; ++d) {
+            centroidData.at(j, d) = sums[j * dims + d] / pointCounts[j];
+        }
+    }
+    rebuildIndex();
+    return labels;
+}
+
+void KMeansModel::save(const std::string &path) const {
+    Dataset rows(size(), dim() + 1);
+    std::vector<std::string> names;
+    for (std::size_t d = 0; d < dim(); ++d) {
+        names.push_back("x" + std::to_string(d));
+    }
+    names.push_back("count");
+    for (std::size_t j = 0; j < size(); ++j) {
+        std::copy(centroidData[j].begin(), centroidData[j].end(), rows.row(j));
+        rows.at(j, dim()) = pointCounts[j];
+    }
+    columnar::save(rows, path, names);
+}
+
+KMeansModel KMeansModel::load(const std::string &path, Index index) {
+    columnar::MappedDataset file(path);
+    if (file.dim() < 2 || file.schema().back().name != "count") {
+        throw std::runtime_error(path + " isn't a KMeansModel file");
+    }
+    std::size_t dims = file.dim() - 1;
+    Dataset centroids(file.size(), dims);
+    std::vector<long> counts(file.size());
+    for (std::size_t d = 0; d < dims; ++d) {
+        for (std::size_t j = 0; j < file.size(); ++j) {
+            centroids.at(j, d) = file.column(d)[j];
+        }
+    }
+    for (std::size_t j = 0; j < file.size(); ++j) {
+        counts[j] = (long) file.column(dims)[j];
+    }
+    return KMeansModel(std::move(centroids), std::move(counts), index);
+}
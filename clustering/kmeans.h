@@ -1,11 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
 #include <vector>
+#include "batchreader.h"
+#include "dataset.h"
+#include "metric.h"
+#include "spatial.h"
+
+struct KMeansResult {
+    Dataset centroids;
+    std::vector<int> labels; // which centroid each point belongs to
+    double inertia = 0; // sum of the distances (squared euclidean by default) from each point to its centroid
+    int iterations = 0;
+    long distanceEvals = 0; // how many point to centroid distances were actually computed
+};
+
+class KMeansModel;
 
 class KMeans {
 public:
-    KMeans(int numClusters_, double threshold_);
+    /*
+     * Lloyd computes every point to centroid distance every iteration.
+     * Elkan and Hamerly keep bounds on each point's distance to the centroids and use the triangle inequality to
+     * skip distances that can't change the assignment, so they give the same clusters with way fewer distance
+     * computations. Elkan keeps k lower bounds per point (fewest distances, k doubles of memory per point),
+     * Hamerly keeps one (less memory and bookkeeping, usually better for small k or many dimensions).
+     * with a metric that has no triangle inequality (metric::Cosine) they just run Lloyd
+     */
+    enum class Algorithm {
+        Lloyd,
+        Elkan,
+        Hamerly
+    };
+
+    // how the starting centroids are picked
+    enum class Init {
+        RandomBox, // uniformly random inside the data's bounding box. can leave clusters empty
+        KMeansPlusPlus, // k-means++, spread out in proportion to squared distance
+        KMeansParallel // k-means||, about as good as k-means++ with only a few passes over the data
+    };
+
+    KMeans(int numClusters_, double threshold_, Algorithm algorithm_ = Algorithm::Lloyd);
+
+    int numClusters; // number of clusters to find, KMeansSearch tries several. fit throws std::invalid_argument if < 1
+    double threshold; // when to stop iterating. average distance the centroids moved in the last iteration
+    Algorithm algorithm;
+    int maxIterations = 300; // in case it never settles below threshold
+    bool verbose = true; // print how far the centroids move every iteration
+    int numThreads = 1; // threads for seeding and Lloyd's assignment step, 0 = one per core
+    Init init = Init::KMeansPlusPlus;
+    std::uint64_t seed = 320; // same seed (and data) = same starting centroids
+
+    /*
+     * Metric is one of the metric.h ones: what the points get assigned by, and what the centroids move to
+     * (Metric::center), e.g. metric::Manhattan gives k-medians and metric::Cosine spherical k-means.
+     * squared euclidean and euclidean give the same clusters. the starting centroids always come from squared
+     * euclidean distances, and the threshold is measured in Metric (euclidean for squared euclidean)
+     */
+    template <typename Metric = metric::SquaredEuclidean>
+    std::vector<Dataset> cluster(DatasetView data); // list of clusters. each one has its points, any dimension
+
+    template <typename Metric = metric::SquaredEuclidean>
+    KMeansResult fit(DatasetView data); // starting centroids picked by init
+    // start from these instead, numClusters of them with the data's dims (std::invalid_argument otherwise)
+    template <typename Metric = metric::SquaredEuclidean>
+    KMeansResult fit(DatasetView data, Dataset initialCentroids);
+
+    // fit (squared euclidean), kept as a model that can label new points and keep learning from them
+    KMeansModel fitModel(DatasetView data);
+
+    Dataset initialCentroids(DatasetView data);
+
+private:
+    Dataset randomCentroids(DatasetView data);
+    Dataset plusPlusCentroids(DatasetView data);
+    Dataset parallelCentroids(DatasetView data);
+    void checkNumClusters() const;
+    // D is the number of dimensions, or metric::dynamic
+    template <typename Metric, std::size_t D>
+    void lloyd(DatasetView data, KMeansResult &result);
+    template <typename Metric, std::size_t D>
+    void elkan(DatasetView data, KMeansResult &result);
+    template <typename Metric, std::size_t D>
+    void hamerly(DatasetView data, KMeansResult &result);
+    // moves the centroids to the Metric::center of their points, fills in how far each one moved and returns the
+    // average
+    template <typename Metric, std::size_t D>
+    double updateCentroids(DatasetView data, KMeansResult &result, std::vector<double> &motion);
+    // same thing when the new positions (k x dims) have already been worked out. clusters with a count of 0 stay put
+    template <typename Metric, std::size_t D>
+    double moveCentroids(const std::vector<double> &positions, const std::vector<long> &counts, KMeansResult &result,
+                         std::vector<double> &motion);
+};
+
+/*
+ * fitted centroids kept around to label new points without clustering again. euclidean only.
+ * every centroid keeps the sum and count of the points it has been given, so update() can fold a new batch in and
+ * move each centroid to the mean of everything it has ever seen without looking at the old points again.
+ * with lots of centroids in few dimensions, assigning uses a KDTree over the centroids instead of checking them all
+ */
+class KMeansModel {
+public:
+    enum class Index {
+        Auto, // KDTree for 64+ centroids in up to 4 dimensions, otherwise Scan
+        Scan, // every centroid, with the simd kernel
+        KDTree // can still win in more dimensions if the points are tightly clustered around the centroids
+    };
+
+    // counts start at 0, so the first update() replaces a centroid with the mean of its new points
+    explicit KMeansModel(Dataset centroids_, Index index_ = Index::Auto);
+    // counts from how many points got each label
+    explicit KMeansModel(const KMeansResult &result, Index index_ = Index::Auto);
+
+    std::size_t size() const { return centroidData.size(); }
+    std::size_t dim() const { return centroidData.dim(); }
+    const Dataset &centroids() const { return centroidData; }
+    const std::vector<long> &counts() const { return pointCounts; }
+    bool usesTree() const { return tree.has_value(); }
+
+    /*
+     * the closest centroid, first one on ties. thread safe as long as nothing is updating the model.
+     * these and update throw std::invalid_argument if the points' dims aren't the model's, and std::logic_error if
+     * the model has no centroids
+     */
+    int assign(PointView point) const;
+    // labels has room for points.size(). numThreads 0 = one per core, 1 doesn't start any threads
+    void assignBatch(DatasetView points, int *labels, int numThreads = 1) const;
+    std::vector<int> assignBatch(DatasetView points, int numThreads = 1) const;
+
+    // assigns points against the current centroids, then adds them into their centroids' sums and counts and moves
+    // the centroids to the new means. returns the labels they got
+    std::vector<int> update(DatasetView points, int numThreads = 1);
+
+    // a columnar dataset file (columnar.h): one row per centroid, its coordinates then its count.
+    // both throw std::runtime_error
+    void save(const std::string &path) const;
+    static KMeansModel load(const std::string &path, Index index = Index::Auto);
+
+private:
+    KMeansModel(Dataset centroids_, std::vector<long> counts_, Index index_); // counts_ can be empty
+    void rebuildIndex(); // after the centroids move
+    void check(std::size_t pointDims) const; // throws if points with pointDims can't be assigned
+    int nearest(const double *point) const; // assign without the checks
+
+    Dataset centroidData;
+    std::vector<long> pointCounts;
+    std::vector<double> sums; // k x dims, sums[j] / pointCounts[j] is centroid j once it has points
+    Index index;
+    std::vector<double> centroidsT; // dims x k, for simd::nearest
+    std::optional<spatial::KDTree> tree;
+};
+
+/*
+ * runs KMeans for every k in [minK, maxK], restarts times each with a different seed, all at once on a thread pool.
+ * keeps the lowest inertia run for each k. the same seed always gives the same results, whatever the thread count
+ */
+class KMeansSearch {
+public:
+    KMeansSearch(int minK_, int maxK_, int restarts_);
+
+    int minK, maxK, restarts;
+    double threshold = 0.01;
+    KMeans::Algorithm algorithm = KMeans::Algorithm::Hamerly;
+    KMeans::Init init = KMeans::Init::KMeansPlusPlus;
+    int maxIterations = 300;
+    std::uint64_t seed = 320;
+    int numThreads = 0; // 0 = one per core
+    // pickK stops at the first k where going to k + 1 improves inertia by less than this fraction (the "elbow")
+    double elbow = 0.1;
+
+    // best run for each k, best[i] is k = minK + i. throws std::invalid_argument unless restarts >= 1 and
+    // 1 <= minK <= maxK
+    std::vector<KMeansResult> run(DatasetView data);
+    // inertia always goes down as k goes up, so the best k is where it stops going down much
+    int pickK(const std::vector<KMeansResult> &best) const;
+};
+
+/*
+ * mini-batch k-means (Sculley, "Web-scale k-means clustering", 2010) for datasets that don't fit in memory.
+ * points come from a BatchReader batchSize at a time, and each centroid moves toward its points with a step of
+ * 1 / (points it has seen so far), so it ends up at the running mean. memory use is the centroids plus one batch,
+ * no matter how big the input is
+ */
+class MiniBatchKMeans {
+public:
+    MiniBatchKMeans(int numClusters_, std::size_t batchSize_ = 4096);
 
-    int numClusters; // number of clusters to find. If extra time, try multiple and optimize
-    double threshold; // when to stop iterating.
-    std::vector<std::vector<std::vector<double>>> cluster(std::vector<std::vector<double>> data); // list of clusters. each one has a list of xy pts
+    int numClusters;
+    std::size_t batchSize;
+    int epochs = 1; // passes over the whole input
+    std::uint64_t seed = 320; // picks the starting centroids out of the first batch
 
-};
\ No newline at end of file
+    Dataset fit(BatchReader &reader); // returns the centroids
+    // final pass: labels every point with its closest centroid and writes them to labelFile, one per line.
+    // returns how many points there were
+    long assign(BatchReader &reader, DatasetView centroids, const std::string &labelFile);
+};
@@ -1,61 +1,182 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include "csv.h"
-#include "datagen.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "asyncwriter.h"
+#include "columnar.h"
 #include "dbscan.h"
 #include "kmeans.h"
 
 /*
- * I chose to hardcode this for 2d data of doubles, because it was very easy to check in spreadsheet software
- * TODO: if i have extra time, make it work for n dimensional data
+ * data is stored in a Dataset (see dataset.h), so everything works for n dimensional data. the output is still
+ * easiest to check in spreadsheet software with 2d data though
  * TODO: const qualify things that don't need to change, and have them be passed as references
- * TODO: change DBscan return type to the same as KMeans so that it can return a list of clusters (requires smol rewrite)
+ *
+ * usage: clustering INPUT [options]
+ *   --out FILE                where the results go (Kmeansed.csv)
+ *   --format clusters         every cluster's points, each cluster followed by 4 "b" lines (the default)
+ *   --format labels           just the cluster of every input point, one per line in input order (-1 for noise)
+ *   --format points           every input point in input order, with its cluster as an extra last column
+ *   --k K --threshold T       KMeans with K >= 1 clusters, stopping when the centroids move less than T (5 and 1)
+ *   --dbscan MAXDIST MINPTS   DBscan instead of KMeans, MAXDIST > 0 and MINPTS >= 0
+ *   --threads N               0 = one per core (the default)
+ * anything else, or a value out of range, prints the usage line
  */
 
-int main() {
-    std::string dataFile = "/Users/danbern/Documents/programming/CS320-Machine-Learning/data/clustered.csv";
-    std::vector data = csv::parse(dataFile, ',');
-
-//    DBscan scanner(10, 5); // 10 maxdist 5 minpts
-//    std::vector<Cluster> clusters = scanner.scan(data);
-//
-//    std::ofstream clusterFile;
-//    clusterFile.open("clusters.csv");
-//
-//    for (Cluster c : clusters) {
-//        for (Point p : c) {
-//            std::cout << p.pos[0] << ", " << p.pos[1] << std::endl;
-//            clusterFile << p.pos[0] << ", " << p.pos[1] << "\n";
-//        }
-//        //break;
-//    }
-//    clusterFile.close();
-
-    KMeans clusterer(5, 1); // 5 clusters, 1 threshold
-    std::vector<std::vector<std::vector<double>>> clusters = clusterer.cluster(data);
-    std::cout << "CLUSTERED" << std::endl;
-
-    std::ofstream clusterFile;
-    clusterFile.open("Kmeansed.csv");
-
-    for (std::vector<std::vector<double>> cluster : clusters) {
-        for (std::vector<double> pt : cluster) {
-            clusterFile << pt[0] << "," << pt[1] << "\n";
+namespace {
+    enum class Format {
+        Clusters,
+        Labels,
+        Points
+    };
+
+    void usage() {
+        std::cerr << "usage: clustering INPUT [--out FILE] [--format clusters|labels|points] [--k K] [--threshold T]"
+                     " [--dbscan MAXDIST MINPTS] [--threads N]" << std::endl;
+    }
+
+    // the whole of text has to be a number, so "--k x" or "--k 5x" is an error rather than 0 or 5
+    bool parse(const char *text, int &out) {
+        char *end;
+        long value = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || value < INT_MIN || value > INT_MAX) {
+            return false;
         }
-        clusterFile << "b\nb\nb\nb\n"; // sometimes the clusters are empty?! maybe two are in the same place
-        std::cout << "cluster written" << std::endl;
+        out = (int) value;
+        return true;
+    }
+
+    bool parse(const char *text, double &out) {
+        char *end;
+        out = std::strtod(text, &end);
+        return end != text && *end == '\0';
     }
 
-    clusterFile.close();
+    /*
+     * the formatting happens here while the AsyncWriter's thread is writing the previous buffer out, and the
+     * points are read in place instead of being copied into a Dataset per cluster first
+     */
+    void writeResults(DatasetView data, const std::vector<int> &labels, int numClusters, Format format,
+                      const std::string &outFile) {
+        AsyncWriter out(outFile);
+        if (format == Format::Labels) {
+            for (int label : labels) {
+                out.number((long) label);
+                out.put('\n');
+            }
+        } else if (format == Format::Points) {
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                for (double value : data[i]) {
+                    out.number(value);
+                    out.put(',');
+                }
+                out.number((long) labels[i]);
+                out.put('\n');
+            }
+        } else {
+            // every cluster's points next to each other (noise left out), keeping their order within a cluster
+            std::vector<std::size_t> starts(numClusters + 1, 0), members;
+            for (int label : labels) {
+                if (label >= 0) {
+                    ++starts[label + 1];
+                }
+            }
+            for (int c = 0; c < numClusters; ++c) {
+                starts[c + 1] += starts[c];
+            }
+            members.resize(starts.back());
+            std::vector<std::size_t> next(starts.begin(), starts.end() - 1);
+            for (std::size_t i = 0; i < labels.size(); ++i) {
+                if (labels[i] >= 0) {
+                    members[next[labels[i]]++] = i;
+                }
+            }
+            for (int c = 0; c < numClusters; ++c) {
+                for (std::size_t m = starts[c]; m < starts[c + 1]; ++m) {
+                    out.row(data[members[m]].data(), data.dim());
+                }
+                out.write("b\nb\nb\nb\n"); // sometimes the clusters are empty?! maybe two are in the same place
+            }
+        }
+        out.close();
+    }
+}
 
+int main(int argc, char **argv) {
+    std::string dataFile, outFile = "Kmeansed.csv";
+    Format format = Format::Clusters;
+    int k = 5, threads = 0, minPts = 0;
+    double threshold = 1, maxDist = 0;
+    bool dbscan = false, ok = true;
+    for (int i = 1; i < argc && ok; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue) {
+            outFile = argv[++i];
+        } else if (arg == "--format" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "clusters") {
+                format = Format::Clusters;
+            } else if (name == "labels") {
+                format = Format::Labels;
+            } else if (name == "points") {
+                format = Format::Points;
+            } else {
+                usage();
+                return 1;
+            }
+        } else if (arg == "--k" && hasValue) {
+            ok = parse(argv[++i], k) && k >= 1;
+        } else if (arg == "--threshold" && hasValue) {
+            ok = parse(argv[++i], threshold) && threshold >= 0;
+        } else if (arg == "--dbscan" && i + 2 < argc) {
+            dbscan = true;
+            ok = parse(argv[++i], maxDist) && maxDist > 0 && std::isfinite(maxDist);
+            ok = parse(argv[++i], minPts) && minPts >= 0 && ok;
+        } else if (arg == "--threads" && hasValue) {
+            ok = parse(argv[++i], threads) && threads >= 0;
+        } else if (dataFile.empty() && arg[0] != '-') {
+            dataFile = arg;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || dataFile.empty()) {
+        usage();
+        return 1;
+    }
+
+    try {
+        // parsed once, then loaded from the binary copy next to it until the csv changes
+        Dataset data = columnar::loadCSV(dataFile, ',', dataFile + ".col", threads);
+
+        std::vector<int> labels;
+        int numClusters;
+        if (dbscan) {
+            DBscan scanner(maxDist, minPts);
+            scanner.numThreads = threads;
+            labels = scanner.labels(data);
+            numClusters = labels.empty() ? 0 : *std::max_element(labels.begin(), labels.end()) + 1;
+        } else {
+            KMeans clusterer(k, threshold);
+            clusterer.numThreads = threads;
+            labels = clusterer.fit(data).labels;
+            numClusters = k;
+        }
+        std::cout << "CLUSTERED" << std::endl;
+
+        writeResults(data, labels, numClusters, format, outFile);
+        std::cout << numClusters << " clusters written to " << outFile << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-//    for (std::vector<double> row : data) {
-//        for (double value : row) {
-//            std::cout << std::to_string(value) << ", ";
-//        }
-//        std::cout << std::endl;
-//    }
     // dataGen::saveCSV(dataGen::generateRandom(500, 500, 0, 0, 1000), "random");
     // dataGen::saveCSV(dataGen::generateClusters(1000, 1000, 0, 0, 300, 5, 100, 100), "clustered");
     return 0;
-}
\ No newline at end of file
+}
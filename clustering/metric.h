@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "dataset.h"
+
+/*
+ * distance functions picked at compile time. KMeans and DBscan take one as a template parameter, so the distance in
+ * their inner loops gets inlined instead of going through a function pointer or a virtual call.
+ * every metric has distance<D>(a, b, dims). when the number of dimensions D is known at compile time the loop over
+ * them is unrolled completely, D = metric::dynamic works for any number. withDims picks between them once, outside
+ * the loop, instead of once per distance. both versions add the terms up in the same order, so they give exactly the
+ * same results (and the same as dataGen::distance)
+ */
+namespace metric {
+    const std::size_t dynamic = 0;
+
+    template <std::size_t D>
+    using FixedPoint = std::array<double, D>;
+
+    // what KMeans moves a centroid to: the point with the smallest total distance to the cluster's points
+    enum class Center {
+        Mean, // for (squared) euclidean
+        Median, // each dimension's median, for manhattan (k-medians)
+        Direction // mean of the points scaled to length 1, for cosine (spherical k-means)
+    };
+
+    template <typename Fn, std::size_t... I>
+    inline void unrolled(Fn &fn, std::index_sequence<I...>) {
+        (fn(I), ...);
+    }
+
+    // fn(d) for every d in [0, dims), in order
+    template <std::size_t D, typename Fn>
+    inline void forDims(std::size_t dims, Fn fn) {
+        if constexpr (D == dynamic) {
+            for (std::size_t d = 0; d < dims; ++d) {
+                fn(d);
+            }
+        } else {
+            unrolled(fn, std::make_index_sequence<D>());
+        }
+    }
+
+    // fn(std::integral_constant<std::size_t, D>()), with D = dims for 1 to 4 dimensions and dynamic for any other
+    template <typename Fn>
+    inline decltype(auto) withDims(std::size_t dims, Fn fn) {
+        switch (dims) {
+            case 1:
+                return fn(std::integral_constant<std::size_t, 1>());
+            case 2:
+                return fn(std::integral_constant<std::size_t, 2>());
+            case 3:
+                return fn(std::integral_constant<std::size_t, 3>());
+            case 4:
+                return fn(std::integral_constant<std::size_t, 4>());
+            default:
+                return fn(std::integral_constant<std::size_t, dynamic>());
+        }
+    }
+
+    /*
+     * every metric also says:
+     *   Triangle: a metric that obeys the triangle inequality and orders distances the same way, which Elkan and
+     *     Hamerly KMeans need for their bounds. void if there isn't one (those fall back to Lloyd)
+     *   euclideanRadius(r): radius of a euclidean ball that holds every point closer than r, so DBscan can get
+     *     candidates from the spatial indexes. infinity if there isn't one (every pair gets checked)
+     *   center: what KMeans uses as a cluster's centroid
+     */
+    struct Euclidean {
+        typedef Euclidean Triangle;
+        static constexpr Center center = Center::Mean;
+
+        template <std::size_t D = dynamic>
+        static double distance(const double *a, const double *b, std::size_t dims = D) {
+            double sum = 0;
+            forDims<D>(dims, [&](std::size_t d) {
+                double diff = a[d] - b[d];
+                sum += diff * diff;
+            });
+            return std::sqrt(sum);
+        }
+
+        static double euclideanRadius(double r) { return r; }
+    };
+
+    // same order as euclidean without the sqrt. the usual one for KMeans, its inertia is the sum of these
+    struct SquaredEuclidean {
+        typedef Euclidean Triangle;
+        static constexpr Center center = Center::Mean;
+
+        template <std::size_t D = dynamic>
+        static double distance(const double *a, const double *b, std::size_t dims = D) {
+            double sum = 0;
+            forDims<D>(dims, [&](std::size_t d) {
+                double diff = a[d] - b[d];
+                sum += diff * diff;
+            });
+            return sum;
+        }
+
+        static double euclideanRadius(double r) { return std::sqrt(r); }
+    };
+
+    struct Manhattan {
+        typedef Manhattan Triangle;
+        static constexpr Center center = Center::Median;
+
+        template <std::size_t D = dynamic>
+        static double distance(const double *a, const double *b, std::size_t dims = D) {
+            double sum = 0;
+            forDims<D>(dims, [&](std::size_t d) { sum += std::abs(a[d] - b[d]); });
+            return sum;
+        }
+
+        // euclidean distance is never more than manhattan
+        static double euclideanRadius(double r) { return r; }
+    };
+
+    // 1 - cos(angle between a and b), from 0 (same direction) to 2 (opposite). 1 if either one is all zeros
+    struct Cosine {
+        typedef void Triangle;
+        static constexpr Center center = Center::Direction;
+
+        template <std::size_t D = dynamic>
+        static double distance(const double *a, const double *b, std::size_t dims = D) {
+            double dot = 0, normA = 0, normB = 0;
+            forDims<D>(dims, [&](std::size_t d) {
+                dot += a[d] * b[d];
+                normA += a[d] * a[d];
+                normB += b[d] * b[d];
+            });
+            double norms = std::sqrt(normA * normB);
+            return norms > 0 ? 1 - dot / norms : 1;
+        }
+
+        // points in the same direction can be any distance apart
+        static double euclideanRadius(double) { return std::numeric_limits<double>::infinity(); }
+    };
+
+    template <typename Metric, std::size_t D>
+    inline double distance(const FixedPoint<D> &a, const FixedPoint<D> &b) {
+        return Metric::template distance<D>(a.data(), b.data(), D);
+    }
+
+    template <typename Metric>
+    inline double distance(PointView a, PointView b) {
+        return Metric::distance(a.data(), b.data(), a.size());
+    }
+}
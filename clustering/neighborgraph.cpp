@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "neighborgraph.h"
+#include "threadpool.h"
+
+spatial::NeighborGraph::NeighborGraph(DatasetView data, double radius_, IndexType indexType, int numThreads) {
+    numPts = data.size();
+    maxRadius = radius_;
+    int dims = data.dim();
+    std::unique_ptr<UniformGrid> grid;
+    std::unique_ptr<KDTree> tree;
+    indexType = effectiveIndex(indexType, dims);
+    if (indexType == IndexType::Grid) {
+        grid = std::make_unique<UniformGrid>(data, maxRadius);
+    } else if (indexType == IndexType::KDTree) {
+        tree = std::make_unique<KDTree>(data);
+    }
+
+    // each block of points gets its own runs first, then they're all copied into the arrays in order. blocks are
+    // handed out one at a time since dense areas take longer
+    const int blockSize = 256;
+    int numBlocks = (numPts + blockSize - 1) / blockSize;
+    std::vector<std::vector<std::pair<double, int>>> blockEdges(numBlocks);
+    std::vector<std::vector<int>> blockCounts(numBlocks);
+    ThreadPool pool(numThreads);
+    std::vector<std::vector<int>> found(pool.size());
+    double r2 = maxRadius * maxRadius;
+    pool.forEach(numBlocks, [&](std::size_t block, int worker) {
+        std::vector<int> &out = found[worker];
+        for (int i = block * blockSize; i < std::min(numPts, (int) (block + 1) * blockSize); ++i) {
+            const double *query = data[i].data();
+            if (grid != nullptr) {
+                grid->radius(query, maxRadius, out);
+            } else if (tree != nullptr) {
+                tree->radius(query, maxRadius, out);
+            } else {
+                out.clear();
+                for (int j = 0; j < numPts; ++j) {
+                    out.push_back(j);
+                }
+            }
+            std::size_t start = blockEdges[block].size();
+            for (int j : out) {
+                if (j == i) {
+                    continue;
+                }
+                // same sum in the same order as the indexes, so < r2 agrees with them exactly
+                double sum = 0;
+                for (int d = 0; d < dims; ++d) {
+                    double diff = query[d] - data[j][d];
+                    sum += diff * diff;
+                }
+                if (sum < r2) {
+                    blockEdges[block].push_back({sum, j});
+                }
+            }
+            std::sort(blockEdges[block].begin() + start, blockEdges[block].end());
+            blockCounts[block].push_back(blockEdges[block].size() - start);
+        }
+    });
+
+    offsets.resize(numPts + 1);
+    offsets[0] = 0;
+    for (int block = 0, i = 0; block < numBlocks; ++block) {
+        for (int c : blockCounts[block]) {
+            offsets[i + 1] = offsets[i] + c;
+            ++i;
+        }
+    }
+    ids.resize(offsets[numPts]);
+    sqDists.resize(offsets[numPts]);
+    pool.forEach(numBlocks, [&](std::size_t block, int) {
+        std::int64_t pos = offsets[block * blockSize];
+        for (const std::pair<double, int> &edge : blockEdges[block]) {
+            sqDists[pos] = edge.first;
+            ids[pos] = edge.second;
+            ++pos;
+        }
+        std::vector<std::pair<double, int>>().swap(blockEdges[block]);
+    });
+}
+
+std::size_t spatial::NeighborGraph::bytes() const {
+    return offsets.size() * sizeof(std::int64_t) + ids.size() * sizeof(int) + sqDists.size() * sizeof(double);
+}
+
+int spatial::NeighborGraph::count(int i, double r) const {
+    if (r > maxRadius) {
+        throw std::invalid_argument("NeighborGraph::count: radius " + std::to_string(r) + " is bigger than the " +
+                                    std::to_string(maxRadius) + " the graph was built with");
+    }
+    const double *begin = sqDistances(i), *end = sqDistances(i + 1);
+    return std::lower_bound(begin, end, r * r) - begin;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dataset.h"
+#include "spatial.h"
+
+namespace spatial {
+    /*
+     * every point's neighbors within radius, found once and kept in compressed sparse row form: one array of
+     * neighbor indices and one of squared distances for all points back to back, and offsets saying where each
+     * point's run starts. each run is sorted closest first, so the neighbors within any smaller radius are just
+     * the front of it. lets a parameter sweep (DBscan with several maxDist/minPts) pay for one neighbor search
+     */
+    class NeighborGraph {
+    public:
+        // indexType goes through effectiveIndex, so Grid on high dimensional data builds a KDTree
+        NeighborGraph(DatasetView data, double radius_, IndexType indexType = IndexType::Grid, int numThreads = 0);
+
+        int size() const { return numPts; }
+        double radius() const { return maxRadius; }
+        std::size_t numEdges() const { return ids.size(); }
+        std::size_t bytes() const; // memory used by the arrays
+
+        // neighbors of point i (not counting i), closest first
+        const int *neighbors(int i) const { return ids.data() + offsets[i]; }
+        const double *sqDistances(int i) const { return sqDists.data() + offsets[i]; }
+        // how many of them are closer than r. r can't be more than radius()
+        int count(int i, double r) const;
+
+    private:
+        int numPts;
+        double maxRadius;
+        std::vector<std::int64_t> offsets; // point i's run is [offsets[i], offsets[i + 1])
+        std::vector<int> ids;
+        std::vector<double> sqDists;
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * counter based random numbers: a hash of (seed, counter) instead of a generator with state, so the nth number
+ * can be made without the n - 1 before it. any thread can make any part of a random sequence on its own and it
+ * comes out the same whatever the thread count
+ */
+namespace rng {
+    // splitmix64's finalizer. turns a counter into a random looking 64 bit number
+    inline std::uint64_t mix(std::uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    inline std::uint64_t bits(std::uint64_t seed, std::uint64_t counter) {
+        return mix(seed ^ mix(counter));
+    }
+
+    // uniform in [0, 1)
+    inline double uniform01(std::uint64_t seed, std::uint64_t counter) {
+        return (bits(seed, counter) >> 11) * 0x1.0p-53;
+    }
+}
@@ -0,0 +1,141 @@
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef void (*DistanceFn)(const double *, const double *, std::size_t, std::size_t, double *);
+
+    void scalarDistances(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *out) {
+        for (std::size_t j = 0; j < k; ++j) {
+            out[j] = 0;
+        }
+        for (std::size_t d = 0; d < dims; ++d) {
+            const double *row = centroidsT + d * k;
+            double x = pt[d];
+            for (std::size_t j = 0; j < k; ++j) {
+                double diff = row[j] - x;
+                out[j] += diff * diff;
+            }
+        }
+    }
+
+#ifdef SIMD_X86
+    __attribute__((target("avx2")))
+    void avx2Distances(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *out) {
+        std::size_t j = 0;
+        for (; j + 4 <= k; j += 4) {
+            __m256d sum = _mm256_setzero_pd();
+            for (std::size_t d = 0; d < dims; ++d) {
+                __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(centroidsT + d * k + j), _mm256_set1_pd(pt[d]));
+                sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+            }
+            _mm256_storeu_pd(out + j, sum);
+        }
+        for (; j < k; ++j) {
+            double sum = 0;
+            for (std::size_t d = 0; d < dims; ++d) {
+                double diff = centroidsT[d * k + j] - pt[d];
+                sum += diff * diff;
+            }
+            out[j] = sum;
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512Distances(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *out) {
+        std::size_t j = 0;
+        for (; j + 8 <= k; j += 8) {
+            __m512d sum = _mm512_setzero_pd();
+            for (std::size_t d = 0; d < dims; ++d) {
+                __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(centroidsT + d * k + j), _mm512_set1_pd(pt[d]));
+                sum = _mm512_add_pd(sum, _mm512_mul_pd(diff, diff));
+            }
+            _mm512_storeu_pd(out + j, sum);
+        }
+        if (j < k) {
+            // leftover centroids with a masked load instead of a scalar loop
+            __mmask8 mask = (__mmask8) ((1u << (k - j)) - 1);
+            __m512d sum = _mm512_setzero_pd();
+            for (std::size_t d = 0; d < dims; ++d) {
+                __m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, centroidsT + d * k + j),
+                                             _mm512_set1_pd(pt[d]));
+                sum = _mm512_add_pd(sum, _mm512_mul_pd(diff, diff));
+            }
+            _mm512_mask_storeu_pd(out + j, mask, sum);
+        }
+    }
+#endif
+
+    simd::Kernel supported(simd::Kernel wanted) {
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        bool has512 = __builtin_cpu_supports("avx512f"), has2 = __builtin_cpu_supports("avx2");
+        if ((wanted == simd::Kernel::Auto || wanted == simd::Kernel::AVX512) && has512) {
+            return simd::Kernel::AVX512;
+        }
+        if (wanted != simd::Kernel::Scalar && has2) {
+            return simd::Kernel::AVX2;
+        }
+#endif
+        return simd::Kernel::Scalar;
+    }
+
+    DistanceFn pick(simd::Kernel kernel) {
+#ifdef SIMD_X86
+        if (kernel == simd::Kernel::AVX512) {
+            return avx512Distances;
+        }
+        if (kernel == simd::Kernel::AVX2) {
+            return avx2Distances;
+        }
+#endif
+        return scalarDistances;
+    }
+
+    struct Dispatch {
+        simd::Kernel active;
+        DistanceFn distances;
+    };
+
+    Dispatch choose(simd::Kernel wanted) {
+        simd::Kernel kernel = supported(wanted);
+        return {kernel, pick(kernel)};
+    }
+
+    // a function local static rather than a global, so kernels called from other static initializers can't run
+    // before it's set
+    Dispatch &dispatch() {
+        static Dispatch current = choose(simd::Kernel::Auto);
+        return current;
+    }
+}
+
+void simd::squaredDistances(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims,
+                            double *out) {
+    dispatch().distances(pt, centroidsT, k, dims, out);
+}
+
+int simd::nearest(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *scratch,
+                  double &bestDist) {
+    dispatch().distances(pt, centroidsT, k, dims, scratch);
+    int best = 0;
+    for (std::size_t j = 1; j < k; ++j) {
+        if (scratch[j] < scratch[best]) {
+            best = j;
+        }
+    }
+    bestDist = scratch[best];
+    return best;
+}
+
+void simd::useKernel(Kernel kernel) {
+    dispatch() = choose(kernel);
+}
+
+const char *simd::kernelName() {
+    Kernel active = dispatch().active;
+    return active == Kernel::AVX512 ? "avx512" : active == Kernel::AVX2 ? "avx2" : "scalar";
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * vectorized distance kernels. the best version the cpu supports (avx-512, avx2 or plain scalar) gets picked the
+ * first time one is called (even from another static initializer), so the same binary runs everywhere.
+ * centroids are passed transposed (dims x k, every centroid's value for dimension d next to each other) so the
+ * vector lanes go across centroids. that way it's fast even for 2d data, where vectorizing across the dimensions
+ * would leave most of each register empty
+ */
+namespace simd {
+    enum class Kernel {
+        Auto, // best available
+        Scalar,
+        AVX2,
+        AVX512
+    };
+
+    // out[j] = squared euclidean distance from pt to centroid j
+    void squaredDistances(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *out);
+
+    // index of the closest centroid (first one on ties). scratch needs room for k doubles
+    int nearest(const double *pt, const double *centroidsT, std::size_t k, std::size_t dims, double *scratch,
+                double &bestDist);
+
+    // for benchmarks. asking for a kernel the cpu doesn't have falls back to the best one it does
+    void useKernel(Kernel kernel);
+    const char *kernelName();
+}
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "spatial.h"
+
+namespace {
+    double sqDist(const double *a, const double *b, int dims) {
+        double sum = 0;
+        for (int i = 0; i < dims; ++i) {
+            double d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    std::string str(double x) {
+        std::ostringstream out;
+        out << x;
+        return out.str();
+    }
+
+    // cell coordinates stay below this, so a query's block of cells (reach to either side) can't overflow an int64
+    const double maxCoord = std::ldexp(1.0, 62);
+}
+
+spatial::KDTree::KDTree(DatasetView data, int leafSize_) {
+    numPts = data.size();
+    numDims = data.dim();
+    leafSize = std::max(1, leafSize_);
+    order.resize(numPts);
+    for (int i = 0; i < numPts; ++i) {
+        order[i] = i;
+    }
+    // build on the original data, then copy it over in tree order
+    pts.assign(data.data(), data.data() + numPts * numDims);
+    if (numPts > 0) {
+        nodes.reserve(2 * numPts / leafSize + 1);
+        build(0, numPts);
+    }
+    std::vector<double> sorted(numPts * numDims);
+    for (int i = 0; i < numPts; ++i) {
+        std::copy(pts.begin() + order[i] * numDims, pts.begin() + (order[i] + 1) * numDims,
+                  sorted.begin() + i * numDims);
+    }
+    pts.swap(sorted);
+}
+
+int spatial::KDTree::build(int begin, int end) {
+    int nodeIndex = nodes.size();
+    nodes.push_back(Node());
+    nodes[nodeIndex].begin = begin;
+    nodes[nodeIndex].end = end;
+    if (end - begin <= leafSize) {
+        return nodeIndex;
+    }
+    // split on the dimension with the biggest spread. pts is still in original order here, so go through order
+    int bestDim = 0;
+    double bestSpread = -1;
+    for (int d = 0; d < numDims; ++d) {
+        double lo = pts[order[begin] * numDims + d], hi = lo;
+        for (int i = begin + 1; i < end; ++i) {
+            double val = pts[order[i] * numDims + d];
+            lo = std::min(lo, val);
+            hi = std::max(hi, val);
+        }
+        if (hi - lo > bestSpread) {
+            bestSpread = hi - lo;
+            bestDim = d;
+        }
+    }
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+        return pts[a * numDims + bestDim] < pts[b * numDims + bestDim];
+    });
+    nodes[nodeIndex].splitDim = bestDim;
+    nodes[nodeIndex].splitVal = pts[order[mid] * numDims + bestDim];
+    // can't hold a reference into nodes across the recursion, it reallocates
+    int left = build(begin, mid);
+    int right = build(mid, end);
+    nodes[nodeIndex].left = left;
+    nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+void spatial::KDTree::radius(const double *query, double radius, std::vector<int> &out) const {
+    out.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    double r2 = radius * radius;
+    int stack[64]; // depth is log2(n / leafSize), so this won't run out
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (node.left == -1) {
+            for (int i = node.begin; i < node.end; ++i) {
+                if (sqDist(query, &pts[i * numDims], numDims) < r2) {
+                    out.push_back(order[i]);
+                }
+            }
+            continue;
+        }
+        double diff = query[node.splitDim] - node.splitVal;
+        // the side the query is on always has to be checked, the other side only if the ball crosses the plane
+        if (diff < 0) {
+            if (diff * diff < r2) {
+                stack[top++] = node.right;
+            }
+            stack[top++] = node.left;
+        } else {
+            if (diff * diff < r2) {
+                stack[top++] = node.left;
+            }
+            stack[top++] = node.right;
+        }
+    }
+}
+
+std::vector<int> spatial::KDTree::radius(PointView query, double radius) const {
+    std::vector<int> out;
+    this->radius(query.data(), radius, out);
+    return out;
+}
+
+std::vector<spatial::Neighbor> spatial::KDTree::nearest(const double *query, int k) const {
+    std::vector<Neighbor> result;
+    if (nodes.empty() || k <= 0) {
+        return result;
+    }
+    auto further = [](const Neighbor &a, const Neighbor &b) { return a.dist < b.dist; };
+    // max heap of the best k so far, distances are squared until the end
+    std::priority_queue<Neighbor, std::vector<Neighbor>, decltype(further)> best(further);
+    auto worst = [&]() { return (int) best.size() < k ? INFINITY : best.top().dist; };
+
+    std::vector<std::pair<int, double>> stack; // node, squared distance to its splitting plane (lower bound)
+    stack.push_back({0, 0.0});
+    while (!stack.empty()) {
+        std::pair<int, double> item = stack.back();
+        stack.pop_back();
+        if (item.second >= worst()) {
+            continue;
+        }
+        const Node &node = nodes[item.first];
+        if (node.left == -1) {
+            for (int i = node.begin; i < node.end; ++i) {
+                double d = sqDist(query, &pts[i * numDims], numDims);
+                if (d < worst()) {
+                    if ((int) best.size() == k) {
+                        best.pop();
+                    }
+                    best.push({order[i], d});
+                }
+            }
+            continue;
+        }
+        double diff = query[node.splitDim] - node.splitVal;
+        int nearChild = diff < 0 ? node.left : node.right;
+        int farChild = diff < 0 ? node.right : node.left;
+        // push far first so near gets popped first
+        stack.push_back({farChild, std::max(item.second, diff * diff)});
+        stack.push_back({nearChild, item.second});
+    }
+    result.resize(best.size());
+    for (int i = result.size() - 1; i >= 0; --i) {
+        result[i] = best.top();
+        result[i].dist = std::sqrt(result[i].dist);
+        best.pop();
+    }
+    return result;
+}
+
+std::vector<spatial::Neighbor> spatial::KDTree::nearest(PointView query, int k) const {
+    return nearest(query.data(), k);
+}
+
+spatial::Neighbor spatial::KDTree::closest(const double *query) const {
+    Neighbor best = {-1, INFINITY}; // squared distance until the end
+    if (nodes.empty()) {
+        return best;
+    }
+    // splits are at the median, so the tree is at most 32 deep for an int number of points, and the stack only
+    // ever holds the far children along one path
+    std::pair<int, double> stack[64];
+    int top = 0;
+    stack[top++] = {0, 0.0};
+    while (top > 0) {
+        std::pair<int, double> item = stack[--top];
+        // > rather than >=, a node exactly as far away could still have a lower index
+        if (item.second > best.dist) {
+            continue;
+        }
+        const Node &node = nodes[item.first];
+        if (node.left == -1) {
+            for (int i = node.begin; i < node.end; ++i) {
+                double d = sqDist(query, &pts[i * numDims], numDims);
+                if (d < best.dist || (d == best.dist && order[i] < best.index)) {
+                    best = {order[i], d};
+                }
+            }
+            continue;
+        }
+        double diff = query[node.splitDim] - node.splitVal;
+        stack[top++] = {diff < 0 ? node.right : node.left, std::max(item.second, diff * diff)};
+        stack[top++] = {diff < 0 ? node.left : node.right, item.second};
+    }
+    best.dist = std::sqrt(best.dist);
+    return best;
+}
+
+spatial::UniformGrid::UniformGrid(DatasetView data, double cellSize_) {
+    // a zero, negative or nan size would make every cell coordinate inf or nan
+    if (!(cellSize_ > 0)) {
+        throw std::invalid_argument("UniformGrid: cellSize " + str(cellSize_) + " has to be positive");
+    }
+    numPts = data.size();
+    numDims = data.dim();
+    cellSize = cellSize_;
+    double maxAbs = 0;
+    for (std::size_t i = 0; i < data.size() * data.dim(); ++i) {
+        maxAbs = std::max(maxAbs, std::fabs(data.data()[i]));
+    }
+    // a tiny cellSize or a huge coordinate would need a cell coordinate past what an int64 holds (nan fails too)
+    if (!(maxAbs / cellSize < maxCoord)) {
+        throw std::invalid_argument("UniformGrid: cellSize " + str(cellSize_) + " is too small for coordinates up to " +
+                                    str(maxAbs));
+    }
+    // figure out each point's cell, then sort points by cell so each cell is one contiguous range
+    std::vector<std::uint64_t> keys(numPts);
+    std::vector<std::int64_t> coords(numDims);
+    for (int i = 0; i < numPts; ++i) {
+        for (int d = 0; d < numDims; ++d) {
+            coords[d] = cellCoord(data[i][d]);
+        }
+        keys[i] = hashCell(coords.data());
+    }
+    order.resize(numPts);
+    for (int i = 0; i < numPts; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+    pts.resize(numPts * numDims);
+    for (int i = 0; i < numPts; ++i) {
+        std::copy(data[order[i]].begin(), data[order[i]].end(), pts.begin() + i * numDims);
+    }
+    int start = 0;
+    for (int i = 1; i <= numPts; ++i) {
+        if (i == numPts || keys[order[i]] != keys[order[start]]) {
+            cells[keys[order[start]]] = {start, i};
+            buckets.push_back({start, i});
+            start = i;
+        }
+    }
+    boxes.resize(buckets.size() * 2 * numDims);
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        double *lo = &boxes[b * 2 * numDims], *hi = lo + numDims;
+        std::copy(&pts[buckets[b].first * numDims], &pts[(buckets[b].first + 1) * numDims], lo);
+        std::copy(lo, hi, hi);
+        for (int i = buckets[b].first + 1; i < buckets[b].second; ++i) {
+            for (int d = 0; d < numDims; ++d) {
+                lo[d] = std::min(lo[d], pts[i * numDims + d]);
+                hi[d] = std::max(hi[d], pts[i * numDims + d]);
+            }
+        }
+    }
+}
+
+std::int64_t spatial::UniformGrid::cellCoord(double val) const {
+    return (std::int64_t) std::floor(val / cellSize);
+}
+
+std::uint64_t spatial::UniformGrid::hashCell(const std::int64_t *coords) const {
+    std::uint64_t h = 1469598103934665603ULL;
+    for (int d = 0; d < numDims; ++d) {
+        // splitmix64 finalizer on each coordinate, mixed into the running hash
+        std::uint64_t x = (std::uint64_t) coords[d] + 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        h = (h ^ x) * 1099511628211ULL;
+    }
+    return h;
+}
+
+void spatial::UniformGrid::radius(const double *query, double radius, std::vector<int> &out) const {
+    out.clear();
+    if (numPts == 0) {
+        return;
+    }
+    // worked out in doubles first, so nothing gets cast to an int64 that doesn't fit
+    double reachCells = std::ceil(radius / cellSize), blockCells = 1;
+    for (int d = 0; d < numDims && blockCells <= buckets.size(); ++d) {
+        blockCells *= 2 * reachCells + 1;
+        if (!(std::fabs(query[d]) / cellSize + reachCells < maxCoord)) {
+            blockCells = INFINITY;
+        }
+    }
+    if (!(blockCells <= buckets.size())) {
+        scanBuckets(query, radius, out);
+        return;
+    }
+    // reused between calls so queries in a loop don't allocate
+    thread_local std::vector<std::int64_t> lo, coords;
+    thread_local std::vector<std::uint64_t> keys;
+    std::int64_t reach = (std::int64_t) reachCells;
+    lo.resize(numDims);
+    coords.resize(numDims);
+    for (int d = 0; d < numDims; ++d) {
+        lo[d] = cellCoord(query[d]) - reach;
+        coords[d] = lo[d];
+    }
+    // go through every cell in the (2 * reach + 1)^dim block around the query, like an odometer
+    keys.clear();
+    while (true) {
+        keys.push_back(hashCell(coords.data()));
+        int d = 0;
+        while (d < numDims && ++coords[d] > lo[d] + 2 * reach) {
+            coords[d] = lo[d];
+            ++d;
+        }
+        if (d == numDims) {
+            break;
+        }
+    }
+    // different cells can hash to the same bucket, don't scan a bucket twice
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    double r2 = radius * radius;
+    for (std::uint64_t key : keys) {
+        auto cell = cells.find(key);
+        if (cell == cells.end()) {
+            continue;
+        }
+        for (int i = cell->second.first; i < cell->second.second; ++i) {
+            if (sqDist(query, &pts[i * numDims], numDims) < r2) {
+                out.push_back(order[i]);
+            }
+        }
+    }
+}
+
+void spatial::UniformGrid::scanBuckets(const double *query, double radius, std::vector<int> &out) const {
+    double r2 = radius * radius;
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        const double *lo = &boxes[b * 2 * numDims], *hi = lo + numDims;
+        double boxDist = 0;
+        for (int d = 0; d < numDims; ++d) {
+            double gap = std::max({lo[d] - query[d], query[d] - hi[d], 0.0});
+            boxDist += gap * gap;
+        }
+        if (!(boxDist < r2)) {
+            continue;
+        }
+        for (int i = buckets[b].first; i < buckets[b].second; ++i) {
+            if (sqDist(query, &pts[i * numDims], numDims) < r2) {
+                out.push_back(order[i]);
+            }
+        }
+    }
+}
+
+std::vector<int> spatial::UniformGrid::radius(PointView query, double radius) const {
+    std::vector<int> out;
+    this->radius(query.data(), radius, out);
+    return out;
+}
+
+spatial::IndexType spatial::effectiveIndex(IndexType indexType, int dims) {
+    if (indexType == IndexType::Grid && dims > UniformGrid::maxDims) {
+        return IndexType::KDTree;
+    }
+    return indexType;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "dataset.h"
+
+/*
+ * spatial indexes so neighbor queries don't have to look at every point.
+ * both indexes keep their own copy of the points, sorted so nearby points are next to each other in memory, so the
+ * data passed in can be thrown away after building.
+ * all distances are euclidean, and radius queries use < (same as the old brute force check in DBscan)
+ */
+namespace spatial {
+    struct Neighbor {
+        int index; // index of the point in the data the index was built from
+        double dist;
+    };
+
+    class KDTree {
+    public:
+        KDTree(DatasetView data, int leafSize_ = 16);
+
+        // indices of every point closer than radius to query. out is cleared first so it can be reused
+        void radius(const double *query, double radius, std::vector<int> &out) const;
+        std::vector<int> radius(PointView query, double radius) const;
+
+        // k closest points sorted by distance (closest first)
+        std::vector<Neighbor> nearest(const double *query, int k) const;
+        std::vector<Neighbor> nearest(PointView query, int k) const;
+        // just the closest point (index -1 if there are none), without allocating anything. ties go to the lowest
+        // index
+        Neighbor closest(const double *query) const;
+
+        int size() const { return numPts; }
+        int dim() const { return numDims; }
+
+    private:
+        struct Node {
+            int begin, end; // range in order
+            int left = -1, right = -1; // children, -1 for leaves
+            int splitDim = 0;
+            double splitVal = 0;
+        };
+
+        int build(int begin, int end);
+
+        int numPts, numDims, leafSize;
+        std::vector<double> pts; // row major copy of the data, stored in tree order so leaves are contiguous
+        std::vector<int> order; // order[i] = original index of the ith point in pts
+        std::vector<Node> nodes;
+    };
+
+    /*
+     * buckets points into cubes with side cellSize. a radius query with radius <= cellSize only has to look at
+     * the 3^dim cells around the query, so it's great for DBscan (cellSize = maxDist) on low dimensional data.
+     * bigger radii still work, they just look at more cells. when the block of cells around the query outnumbers
+     * the occupied ones (high dimensions, or a radius much bigger than cellSize) the query goes through the
+     * occupied cells instead, skipping any whose points are all too far
+     */
+    class UniformGrid {
+    public:
+        static const int maxDims = 4; // past this the 3^dim cells cost more than a KDTree, see effectiveIndex
+
+        // throws std::invalid_argument unless cellSize_ > 0 and every coordinate / cellSize_ fits in an int64
+        UniformGrid(DatasetView data, double cellSize_);
+
+        void radius(const double *query, double radius, std::vector<int> &out) const;
+        std::vector<int> radius(PointView query, double radius) const;
+
+        int size() const { return numPts; }
+        int dim() const { return numDims; }
+
+    private:
+        std::int64_t cellCoord(double val) const; // val / cellSize has to be in range, see maxCoord
+        std::uint64_t hashCell(const std::int64_t *coords) const;
+        // the fallback: every bucket whose bounding box is closer than radius
+        void scanBuckets(const double *query, double radius, std::vector<int> &out) const;
+
+        int numPts, numDims;
+        double cellSize;
+        std::vector<double> pts; // sorted by cell, like KDTree
+        std::vector<int> order;
+        // cell hash -> range in pts. hash collisions just put two cells in the same bucket, which is fine
+        // because every candidate gets its real distance checked anyway
+        std::unordered_map<std::uint64_t, std::pair<int, int>> cells;
+        std::vector<std::pair<int, int>> buckets; // the same ranges as a list
+        std::vector<double> boxes; // each bucket's lowest then highest corner, 2 * numDims per bucket
+    };
+
+    enum class IndexType {
+        BruteForce, // the old O(n^2) way, mostly for checking the others
+        KDTree,
+        Grid
+    };
+
+    // indexType, except that Grid becomes KDTree for more than UniformGrid::maxDims dimensions
+    IndexType effectiveIndex(IndexType indexType, int dims);
+}
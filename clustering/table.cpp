@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include "mappedfile.h"
+#include "table.h"
+
+namespace {
+    struct Field {
+        std::string text;
+        long column; // 1 based character position in the line, for errors
+    };
+
+    /*
+     * splits [p, end) at sep into fields, unquoting quoted ones and trimming spaces around unquoted ones.
+     * returns the number of fields (fields only grows, so the strings get reused from line to line), or -1 with
+     * problem and errColumn set for an unterminated quote
+     */
+    long splitLine(const char *p, const char *end, char sep, std::vector<Field> &fields, std::string &problem,
+                   long &errColumn) {
+        const char *lineStart = p;
+        long count = 0;
+        while (true) {
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if ((long) fields.size() == count) {
+                fields.emplace_back();
+            }
+            Field &field = fields[count++];
+            field.text.clear();
+            field.column = p - lineStart + 1;
+            if (p < end && *p == '"') {
+                const char *open = p++;
+                while (true) {
+                    const char *quote = static_cast<const char *>(std::memchr(p, '"', end - p));
+                    if (quote == nullptr) {
+                        problem = "quote never closed";
+                        errColumn = open - lineStart + 1;
+                        return -1;
+                    }
+                    field.text.append(p, quote);
+                    p = quote + 1;
+                    if (p < end && *p == '"') {
+                        field.text += '"'; // "" is an escaped quote
+                        ++p;
+                    } else {
+                        break;
+                    }
+                }
+                while (p < end && *p != sep) {
+                    ++p; // anything between the closing quote and sep is ignored
+                }
+            } else {
+                const char *start = p;
+                while (p < end && *p != sep) {
+                    ++p;
+                }
+                const char *last = p;
+                while (last > start && (last[-1] == ' ' || last[-1] == '\t')) {
+                    --last;
+                }
+                field.text.assign(start, last);
+            }
+            if (p == end) {
+                return count;
+            }
+            ++p; // past sep
+        }
+    }
+
+    // the whole of text as a number. empty is nan (a missing value)
+    bool toNumber(const std::string &text, double &out) {
+        if (text.empty()) {
+            out = std::numeric_limits<double>::quiet_NaN();
+            return true;
+        }
+        const char *p = text.data(), *end = p + text.size();
+        if (*p == '+') {
+            ++p; // from_chars doesn't take a leading +
+        }
+        std::from_chars_result result = std::from_chars(p, end, out);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+}
+
+csv::Table csv::Table::read(const std::string &fileName, char sep, const std::map<std::string, ColumnType> &schema) {
+    MappedFile file;
+    try {
+        file = MappedFile(fileName);
+    } catch (const std::runtime_error &e) {
+        throw ParseError(fileName, 0, 0, e.what());
+    }
+    Table table;
+    std::vector<std::unordered_map<std::string, std::int32_t>> lookups;
+    std::vector<Field> fields, earlier;
+    std::string problem;
+    long errColumn = 0, lineNum = 0;
+    bool haveHeader = false;
+    // where every data row's line starts, kept while any column is still Auto, so one that turns out to be
+    // categorical can go back for the text of the rows it has only stored as numbers
+    std::vector<std::size_t> lineStarts;
+    bool anyAuto = false;
+    auto encode = [&](std::size_t j, const std::string &text) {
+        Column &column = table.columns[j];
+        auto found = lookups[j].try_emplace(text, (std::int32_t) column.dictionary.size());
+        if (found.second) {
+            column.dictionary.push_back(text);
+        }
+        column.codes.push_back(found.first->second);
+    };
+    const char *p = file.data(), *fileEnd = p + file.size();
+    while (p < fileEnd) {
+        const char *end = static_cast<const char *>(std::memchr(p, '\n', fileEnd - p));
+        const char *next = end == nullptr ? fileEnd : end + 1;
+        end = end == nullptr ? fileEnd : end;
+        if (end > p && end[-1] == '\r') {
+            --end;
+        }
+        ++lineNum;
+        const char *line = p;
+        p = next;
+        const char *nonBlank = line;
+        while (nonBlank < end && (*nonBlank == ' ' || *nonBlank == '\t')) {
+            ++nonBlank;
+        }
+        if (nonBlank == end) {
+            continue;
+        }
+        long count = splitLine(line, end, sep, fields, problem, errColumn);
+        if (count < 0) {
+            throw ParseError(fileName, lineNum, errColumn, problem);
+        }
+        if (!haveHeader) {
+            haveHeader = true;
+            for (long j = 0; j < count; ++j) {
+                Column column;
+                column.name = fields[j].text;
+                auto given = schema.find(column.name);
+                column.type = given == schema.end() ? ColumnType::Auto : given->second;
+                anyAuto = anyAuto || column.type == ColumnType::Auto;
+                table.columns.push_back(std::move(column));
+            }
+            lookups.resize(count);
+            continue;
+        }
+        if (count != (long) table.columns.size()) {
+            throw ParseError(fileName, lineNum, end - line + 1,
+                             "expected " + std::to_string(table.columns.size()) + " values but found " +
+                             std::to_string(count));
+        }
+        if (anyAuto) {
+            lineStarts.push_back(line - file.data());
+        }
+        for (long j = 0; j < count; ++j) {
+            Column &column = table.columns[j];
+            const std::string &text = fields[j].text;
+            if (column.type != ColumnType::Categorical) {
+                double value;
+                if (toNumber(text, value)) {
+                    column.values.push_back(value);
+                    continue;
+                }
+                if (column.type == ColumnType::Numeric) {
+                    throw ParseError(fileName, lineNum, fields[j].column,
+                                     "expected a number in column " + column.name);
+                }
+                // turns out it's categorical: encode the text of the rows so far, which all parsed before
+                column.type = ColumnType::Categorical;
+                column.values = std::vector<double>();
+                column.codes.reserve(lineStarts.size());
+                for (std::size_t r = 0; r < table.rows; ++r) {
+                    const char *start = file.data() + lineStarts[r];
+                    const char *stop = static_cast<const char *>(std::memchr(start, '\n', fileEnd - start));
+                    stop = stop == nullptr ? fileEnd : stop;
+                    if (stop > start && stop[-1] == '\r') {
+                        --stop;
+                    }
+                    splitLine(start, stop, sep, earlier, problem, errColumn);
+                    encode(j, earlier[j].text);
+                }
+                anyAuto = std::any_of(table.columns.begin(), table.columns.end(),
+                                      [](const Column &c) { return c.type == ColumnType::Auto; });
+                if (!anyAuto) {
+                    lineStarts = std::vector<std::size_t>();
+                }
+            }
+            encode(j, text);
+        }
+        ++table.rows;
+    }
+    for (Column &column : table.columns) {
+        if (column.type == ColumnType::Auto) {
+            column.type = ColumnType::Numeric;
+        }
+    }
+    return table;
+}
+
+std::size_t csv::Table::index(const std::string &name) const {
+    for (std::size_t j = 0; j < columns.size(); ++j) {
+        if (columns[j].name == name) {
+            return j;
+        }
+    }
+    throw std::invalid_argument("Table: no column named " + name);
+}
+
+std::vector<std::size_t> csv::Table::indices(const std::vector<std::string> &names) const {
+    std::vector<std::size_t> result;
+    if (names.empty()) {
+        for (std::size_t j = 0; j < columns.size(); ++j) {
+            result.push_back(j);
+        }
+    }
+    for (const std::string &name : names) {
+        result.push_back(index(name));
+    }
+    return result;
+}
+
+Dataset csv::Table::toDataset(const std::vector<std::string> &names) const {
+    std::vector<std::size_t> which = indices(names);
+    Dataset data(rows, which.size());
+    for (std::size_t c = 0; c < which.size(); ++c) {
+        const Column &column = columns[which[c]];
+        for (std::size_t i = 0; i < rows; ++i) {
+            data.row(i)[c] = column.type == ColumnType::Numeric ? column.values[i] : column.codes[i];
+        }
+    }
+    return data;
+}
+
+csv::OneHotView csv::Table::oneHot(const std::vector<std::string> &names) const {
+    return OneHotView(*this, indices(names));
+}
+
+csv::OneHotView::OneHotView(const Table &table_, std::vector<std::size_t> columns_)
+        : table(&table_), columns(std::move(columns_)) {
+    offsets.push_back(0);
+    for (std::size_t j : columns) {
+        const Table::Column &column = table->column(j);
+        offsets.push_back(offsets.back() + (column.type == ColumnType::Numeric ? 1 : column.dictionary.size()));
+    }
+}
+
+double csv::OneHotView::at(std::size_t i, std::size_t j) const {
+    // the table column that expanded column j came from
+    std::size_t c = std::upper_bound(offsets.begin(), offsets.end(), j) - offsets.begin() - 1;
+    const Table::Column &column = table->column(columns[c]);
+    if (column.type == ColumnType::Numeric) {
+        return column.values[i];
+    }
+    return (std::size_t) column.codes[i] == j - offsets[c] ? 1 : 0;
+}
+
+void csv::OneHotView::row(std::size_t i, double *out) const {
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        const Table::Column &column = table->column(columns[c]);
+        if (column.type == ColumnType::Numeric) {
+            out[offsets[c]] = column.values[i];
+        } else {
+            std::fill(out + offsets[c], out + offsets[c + 1], 0.0);
+            out[offsets[c] + column.codes[i]] = 1;
+        }
+    }
+}
+
+std::vector<double> csv::OneHotView::row(std::size_t i) const {
+    std::vector<double> out(dim());
+    row(i, out.data());
+    return out;
+}
+
+Dataset csv::OneHotView::toDataset() const {
+    Dataset data(size(), dim());
+    for (std::size_t i = 0; i < size(); ++i) {
+        row(i, data.row(i));
+    }
+    return data;
+}
+
+std::vector<std::string> csv::OneHotView::names() const {
+    std::vector<std::string> result;
+    for (std::size_t j : columns) {
+        const Table::Column &column = table->column(j);
+        if (column.type == ColumnType::Numeric) {
+            result.push_back(column.name);
+        }
+        for (const std::string &value : column.dictionary) {
+            result.push_back(column.name + "=" + value);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "csv.h"
+#include "dataset.h"
+
+namespace csv {
+    enum class ColumnType {
+        Auto, // numeric if every value is a number (quoted or not), otherwise categorical
+        Numeric,
+        Categorical
+    };
+
+    class OneHotView;
+
+    /*
+     * a csv with a header row and columns of different types, like the UCI student data:
+     *   school;sex;age;...
+     *   "GP";"F";18;...
+     * stored a column at a time. numeric columns are doubles (an empty value is nan), categorical ones are dictionary
+     * encoded: every distinct string gets a code, in order of first appearance, and the column stores the codes.
+     * values can be quoted ("" inside quotes is a quote, and sep inside quotes isn't a separator), and the file is read
+     * in one pass, types being inferred as it goes (see read for the one exception).
+     * toDataset and oneHot turn the columns into what KMeans, DBscan and net::Network take
+     */
+    class Table {
+    public:
+        struct Column {
+            std::string name;
+            ColumnType type;
+            std::vector<double> values; // numeric only
+            std::vector<std::int32_t> codes; // categorical only, one per row
+            std::vector<std::string> dictionary; // categorical only, dictionary[code] is the string
+        };
+
+        /*
+         * schema gives the type of any column by name, the rest are Auto. an Auto column is stored as numbers until
+         * a value isn't one, then the rows before it are split again for their text. that needs every row's offset
+         * in the file (8 bytes a row) kept while any column is Auto, so naming the columns here saves memory.
+         * throws ParseError if a row has the wrong number of values or a Numeric column has something that isn't a
+         * number
+         */
+        static Table read(const std::string &fileName, char sep,
+                          const std::map<std::string, ColumnType> &schema = {});
+
+        std::size_t size() const { return rows; }
+        std::size_t numColumns() const { return columns.size(); }
+        const Column &column(std::size_t j) const { return columns[j]; }
+        const Column &column(const std::string &name) const { return columns[index(name)]; }
+        std::size_t index(const std::string &name) const; // throws std::invalid_argument if there's no such column
+
+        // the named columns (all of them if names is empty) as a row major Dataset, categorical ones as their codes
+        Dataset toDataset(const std::vector<std::string> &names = {}) const;
+        // the named columns with every categorical one as one 0/1 column per string, without copying anything
+        OneHotView oneHot(const std::vector<std::string> &names = {}) const;
+
+    private:
+        std::vector<std::size_t> indices(const std::vector<std::string> &names) const;
+
+        std::size_t rows = 0;
+        std::vector<Column> columns;
+    };
+
+    /*
+     * a Table's columns with the categorical ones one hot encoded, worked out when asked for instead of stored: a
+     * column with m strings becomes m columns, 1 in the one for the row's string and 0 in the rest. numeric columns
+     * come through as they are.
+     * row() gives a point at a time (e.g. as net::Network::feedForward input), toDataset() all of them for
+     * KMeans/DBscan. only valid as long as the Table
+     */
+    class OneHotView {
+    public:
+        OneHotView(const Table &table_, std::vector<std::size_t> columns_);
+
+        std::size_t size() const { return table->size(); }
+        std::size_t dim() const { return offsets.back(); }
+        double at(std::size_t i, std::size_t j) const;
+        void row(std::size_t i, double *out) const; // out has room for dim() values
+        std::vector<double> row(std::size_t i) const;
+        Dataset toDataset() const;
+        std::vector<std::string> names() const; // "name" for numeric columns, "name=string" for the expanded ones
+
+    private:
+        const Table *table;
+        std::vector<std::size_t> columns; // which of the table's columns
+        std::vector<std::size_t> offsets; // where each one starts in a row, plus the total at the end
+    };
+}
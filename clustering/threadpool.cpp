@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <atomic>
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int numThreads_) {
+    numThreads = numThreads_ > 0 ? numThreads_ : std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t n, const std::function<void(std::size_t, std::size_t, int)> &fn) {
+    if (numThreads == 1) {
+        fn(0, n, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobSize = n;
+        remaining = numThreads - 1;
+        error = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+    runShare(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return remaining == 0; });
+    job = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::forEach(std::size_t n, const std::function<void(std::size_t, int)> &fn) {
+    std::atomic<std::size_t> next(0);
+    parallelFor(numThreads, [&](std::size_t, std::size_t, int worker) {
+        for (std::size_t i = next++; i < n; i = next++) {
+            fn(i, worker);
+        }
+    });
+}
+
+void ThreadPool::runShare(int worker) {
+    std::size_t begin = jobSize * worker / numThreads, end = jobSize * (worker + 1) / numThreads;
+    try {
+        (*job)(begin, end, worker);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(int worker) {
+    long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        runShare(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --remaining;
+        }
+        finished.notify_one();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * fixed set of worker threads that sleep between jobs, so algorithms that go parallel once per iteration don't
+ * pay for creating threads every time. the thread calling parallelFor does a share of the work too.
+ * one job at a time: parallelFor is not meant to be called from several threads at once
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads_ = 0); // 0 = one per core
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return numThreads; }
+
+    /*
+     * splits [0, n) into size() contiguous ranges and calls fn(begin, end, worker) for each, worker being
+     * 0 to size() - 1, so it can index per thread buffers. returns when they're all done. if any of them throws,
+     * the first exception is rethrown here
+     */
+    void parallelFor(std::size_t n, const std::function<void(std::size_t, std::size_t, int)> &fn);
+
+    // calls fn(i, worker) for every i in [0, n), handing out one i at a time to whichever thread is free.
+    // better than parallelFor when the jobs take very different amounts of time
+    void forEach(std::size_t n, const std::function<void(std::size_t, int)> &fn);
+
+private:
+    void workerLoop(int worker);
+    void runShare(int worker);
+
+    int numThreads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    const std::function<void(std::size_t, std::size_t, int)> *job = nullptr;
+    std::size_t jobSize = 0;
+    long generation = 0; // bumped for every job so workers can tell a new one from a spurious wakeup
+    int remaining = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+};
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "benchreport.h"
+
+namespace {
+    struct Result {
+        std::string benchmark, name;
+        long n;
+        double seconds;
+        long bytes; // -1 if there's no byte count
+    };
+
+    std::string current; // the benchmark that's running
+    std::vector<Result> results;
+    std::set<std::string> failures; // benchmarks that printed a MISMATCH
+
+    std::string quoted(const std::string &text) {
+        std::string out = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if ((unsigned char) c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    // json has no inf or nan
+    struct Number {
+        double value;
+    };
+
+    std::ostream &operator<<(std::ostream &out, Number number) {
+        if (!std::isfinite(number.value)) {
+            return out << "null";
+        }
+        return out << number.value;
+    }
+
+    // for the console, where a rate from a time too short to measure is just inf
+    std::string rate(double perSecond) {
+        return std::isfinite(perSecond) ? std::to_string((long) perSecond) : "inf";
+    }
+}
+
+double bench::secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void bench::report(const std::string &name, long n, double seconds) {
+    results.push_back({current, name, n, seconds, -1});
+    std::cout << name << " n=" << n << " " << seconds << "s " << rate(n / seconds) << "/s" << std::endl;
+}
+
+void bench::report(const std::string &name, long n, double seconds, long bytes) {
+    results.push_back({current, name, n, seconds, bytes});
+    std::cout << name << " n=" << n << " " << seconds << "s " << rate(n / seconds) << "/s "
+              << bytes / seconds / 1e6 << "MB/s" << std::endl;
+}
+
+std::ostream &bench::mismatch() {
+    failures.insert(current);
+    return std::cout << "MISMATCH: ";
+}
+
+const std::set<std::string> &bench::failed() {
+    return failures;
+}
+
+std::string bench::tempPath(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void bench::start(const std::string &name) {
+    current = name;
+}
+
+void bench::writeJSON(const std::string &path, const std::string &suite, long maxN,
+                      const std::vector<std::pair<std::string, std::string>> &info) {
+    std::ofstream out(path);
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    out.precision(17);
+    out << "{\n  \"suite\": " << quoted(suite) << ",\n  \"date\": " << quoted(date)
+        << ",\n  \"compiler\": " << quoted(__VERSION__);
+    for (const std::pair<std::string, std::string> &field : info) {
+        out << ",\n  " << quoted(field.first) << ": " << quoted(field.second);
+    }
+    out << ",\n  \"cores\": " << std::thread::hardware_concurrency() << ",\n  \"maxN\": " << maxN
+        << ",\n  \"failed\": [";
+    // by name too, in case a benchmark that failed didn't report any results
+    for (auto name = failures.begin(); name != failures.end(); ++name) {
+        out << (name == failures.begin() ? "" : ", ") << quoted(*name);
+    }
+    out << "],\n  \"results\": [";
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const Result &result = results[r];
+        out << (r == 0 ? "\n" : ",\n") << "    {\"benchmark\": " << quoted(result.benchmark) << ", \"name\": "
+            << quoted(result.name) << ", \"n\": " << result.n << ", \"seconds\": " << Number{result.seconds}
+            << ", \"perSecond\": " << Number{result.n / result.seconds};
+        if (result.bytes >= 0) {
+            out << ", \"bytes\": " << result.bytes << ", \"bytesPerSecond\": " << Number{result.bytes / result.seconds};
+        }
+        out << ", \"mismatch\": " << (failures.count(result.benchmark) > 0 ? "true" : "false") << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out) {
+        std::cerr << "couldn't write " << path << std::endl;
+    }
+}
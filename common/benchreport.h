@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * what the benchmarks in clustering and neuralNets report through. results are printed as they come in and kept for
+ * --json, which writes one record per result. a record's "mismatch" is true if its benchmark failed any of its own
+ * checks (and "failed" lists those benchmarks), so a regression in correctness shows up in the json as well as a
+ * regression in speed
+ */
+namespace bench {
+    typedef std::chrono::steady_clock Clock;
+
+    double secondsSince(Clock::time_point start);
+
+    // prints one result line: what was run, on how many items, how long it took and the throughput. every result
+    // also goes in the --json file, under the benchmark that's running
+    void report(const std::string &name, long n, double seconds);
+    void report(const std::string &name, long n, double seconds, long bytes); // also prints MB/s
+
+    // prints "MISMATCH: " and hands back std::cout for the rest of the message. marks the running benchmark failed
+    std::ostream &mismatch();
+    // the benchmarks that called mismatch, for benchmarks.cpp's exit status
+    const std::set<std::string> &failed();
+
+    // a path in the temp directory for scratch files
+    std::string tempPath(const std::string &name);
+
+    // for benchmarks.cpp: everything reported from here on belongs to the benchmark called name
+    void start(const std::string &name);
+    /*
+     * every result so far as json. info is extra strings for the header, like which simd kernel ran. numbers
+     * that aren't finite (a rate from a time too short to measure) are written as null
+     */
+    void writeJSON(const std::string &path, const std::string &suite, long maxN,
+                   const std::vector<std::pair<std::string, std::string>> &info = {});
+}
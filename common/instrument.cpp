@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "instrument.h"
+
+namespace {
+    // stats are only looked up once per place they're used, so a mutex is fine here. the registry and the stats are
+    // leaked on purpose, so they're still around for the report written at exit
+    std::mutex &registryMutex() {
+        static std::mutex *mutex = new std::mutex;
+        return *mutex;
+    }
+
+    std::vector<instrument::Stat *> &registry() {
+        static std::vector<instrument::Stat *> *stats = new std::vector<instrument::Stat *>;
+        return *stats;
+    }
+
+    std::atomic<instrument::Listener> listener{nullptr};
+
+    template <typename StatType>
+    StatType &find(const char *name) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (instrument::Stat *stat : registry()) {
+            if (std::strcmp(stat->name, name) == 0) {
+                StatType *found = dynamic_cast<StatType *>(stat);
+                if (found == nullptr) {
+                    throw std::logic_error(std::string("instrument: ") + name + " is already a " + stat->kind());
+                }
+                return *found;
+            }
+        }
+        StatType *made = new StatType(name);
+        registry().push_back(made);
+        return *made;
+    }
+
+    void updateMax(std::atomic<std::int64_t> &target, std::int64_t value) {
+        std::int64_t current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    template <typename Better>
+    void update(std::atomic<double> &target, double value, Better better) {
+        double current = target.load(std::memory_order_relaxed);
+        while (better(value, current) && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void add(std::atomic<double> &target, double value) {
+        double current = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void writeValue(std::ostream &out, bool json, const char *key, double value, bool first = false) {
+        if (json) {
+            out << (first ? "" : ", ") << "\"" << key << "\": ";
+            if (std::isfinite(value)) {
+                out << value;
+            } else {
+                out << "null";
+            }
+        } else {
+            out << key << "," << value << "\n";
+        }
+    }
+
+    // names are string literals in this code, so json escaping only has to cover quotes and backslashes
+    void writeName(std::ostream &out, const char *name) {
+        for (const char *c = name; *c != '\0'; ++c) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+    }
+
+    std::vector<instrument::Stat *> sortedStats() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::vector<instrument::Stat *> stats = registry();
+        std::sort(stats.begin(), stats.end(), [](const instrument::Stat *a, const instrument::Stat *b) {
+            return std::string(a->name) < std::string(b->name);
+        });
+        return stats;
+    }
+
+    // CS320_PROFILE=path writes everything out when the program exits
+    struct ExitReport {
+        ~ExitReport() {
+            const char *path = std::getenv("CS320_PROFILE");
+            if (path == nullptr || *path == '\0') {
+                return;
+            }
+            try {
+                instrument::write(path);
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    };
+
+#ifdef CS320_INSTRUMENT
+    ExitReport exitReport;
+#endif
+}
+
+void instrument::Counter::reset() {
+    total.store(0, std::memory_order_relaxed);
+}
+
+void instrument::Counter::write(std::ostream &out, bool json) const {
+    writeValue(out, json, "value", (double) value(), true);
+}
+
+void instrument::Timer::add(std::int64_t nanoseconds) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    updateMax(longest, nanoseconds);
+}
+
+void instrument::Timer::reset() {
+    calls.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    longest.store(0, std::memory_order_relaxed);
+}
+
+void instrument::Timer::write(std::ostream &out, bool json) const {
+    std::int64_t n = calls.load(std::memory_order_relaxed);
+    double seconds = total.load(std::memory_order_relaxed) / 1e9;
+    writeValue(out, json, "calls", (double) n, true);
+    writeValue(out, json, "seconds", seconds);
+    writeValue(out, json, "meanSeconds", n == 0 ? 0 : seconds / n);
+    writeValue(out, json, "maxSeconds", longest.load(std::memory_order_relaxed) / 1e9);
+}
+
+void instrument::Histogram::record(double value) {
+    int bucket = 0;
+    if (value >= 1) {
+        int exponent = numBuckets; // for inf, which frexp doesn't give an exponent for
+        if (std::isfinite(value)) {
+            std::frexp(value, &exponent); // value is in [2^(exponent-1), 2^exponent)
+        }
+        bucket = std::min(exponent, numBuckets - 1);
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    update(min, value, [](double a, double b) { return a < b; });
+    update(max, value, [](double a, double b) { return a > b; });
+    add(sum, value);
+}
+
+void instrument::Histogram::reset() {
+    for (std::atomic<std::int64_t> &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    min.store(HUGE_VAL, std::memory_order_relaxed);
+    max.store(-HUGE_VAL, std::memory_order_relaxed);
+}
+
+void instrument::Histogram::write(std::ostream &out, bool json) const {
+    std::int64_t n = count.load(std::memory_order_relaxed);
+    writeValue(out, json, "count", (double) n, true);
+    writeValue(out, json, "sum", sum.load(std::memory_order_relaxed));
+    writeValue(out, json, "mean", n == 0 ? 0 : sum.load(std::memory_order_relaxed) / n);
+    writeValue(out, json, "min", n == 0 ? 0 : min.load(std::memory_order_relaxed));
+    writeValue(out, json, "max", n == 0 ? 0 : max.load(std::memory_order_relaxed));
+    // buckets are keyed by their upper bound, empty ones left out
+    if (json) {
+        out << ", \"buckets\": {";
+    }
+    bool first = true;
+    for (int b = 0; b < numBuckets; ++b) {
+        std::int64_t inBucket = buckets[b].load(std::memory_order_relaxed);
+        if (inBucket == 0) {
+            continue;
+        }
+        std::string key = b == numBuckets - 1 ? "inf" : "<" + std::to_string(std::ldexp(1.0, b));
+        key = key.substr(0, key.find('.')); // to_string gives 6 decimals
+        if (json) {
+            out << (first ? "" : ", ") << "\"" << key << "\": " << inBucket;
+        } else {
+            out << "bucket" << key << "," << inBucket << "\n";
+        }
+        first = false;
+    }
+    if (json) {
+        out << "}";
+    }
+}
+
+instrument::Counter &instrument::counter(const char *name) {
+    return find<Counter>(name);
+}
+
+instrument::Timer &instrument::timer(const char *name) {
+    return find<Timer>(name);
+}
+
+instrument::Histogram &instrument::histogram(const char *name) {
+    return find<Histogram>(name);
+}
+
+void instrument::setListener(Listener listener_) {
+    listener.store(listener_, std::memory_order_release);
+}
+
+void instrument::event(const char *name, double value) {
+    Listener current = listener.load(std::memory_order_acquire);
+    if (current != nullptr) {
+        current(name, value);
+    }
+}
+
+void instrument::writeJSON(std::ostream &out) {
+    std::vector<Stat *> stats = sortedStats();
+    out.precision(15);
+    out << "{";
+    for (std::size_t s = 0; s < stats.size(); ++s) {
+        out << (s == 0 ? "\n" : ",\n") << "  \"";
+        writeName(out, stats[s]->name);
+        out << "\": {\"kind\": \"" << stats[s]->kind() << "\", ";
+        stats[s]->write(out, true);
+        out << "}";
+    }
+    out << "\n}\n";
+}
+
+void instrument::writeCSV(std::ostream &out) {
+    out.precision(15);
+    out << "name,kind,key,value\n";
+    for (Stat *stat : sortedStats()) {
+        // every line the stat writes gets its name and kind in front
+        std::ostringstream values;
+        values.precision(15);
+        stat->write(values, false);
+        std::istringstream lines(values.str());
+        for (std::string line; std::getline(lines, line);) {
+            out << stat->name << "," << stat->kind() << "," << line << "\n";
+        }
+    }
+}
+
+void instrument::write(const std::string &path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("instrument: can't open " + path);
+    }
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        writeCSV(out);
+    } else {
+        writeJSON(out);
+    }
+    if (!out) {
+        throw std::runtime_error("instrument: failed writing " + path);
+    }
+}
+
+void instrument::reset() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (Stat *stat : registry()) {
+        stat->reset();
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * counters, phase timers and histograms for the hot paths (KMeans, DBscan and csv in clustering, Network and Trainer
+ * in neuralNets, which both build this copy), cheap enough to leave in production builds. stats are looked up by
+ * name once per place they're used (the macros keep a static reference) and updated with relaxed atomics after that,
+ * so any thread can update anything without locks.
+ * the code only uses the INSTRUMENT_* macros below, which compile to nothing (arguments not even evaluated) unless
+ * CS320_INSTRUMENT is defined (cmake -DINSTRUMENT=ON). with it defined, setting CS320_PROFILE=file.json (or .csv)
+ * writes everything to that file when the program exits, so a job can be profiled without touching its code
+ */
+namespace instrument {
+    // something that can go in the report
+    class Stat {
+    public:
+        explicit Stat(const char *name_) : name(name_) {}
+        virtual ~Stat() = default;
+        Stat(const Stat &) = delete;
+        Stat &operator=(const Stat &) = delete;
+
+        const char *name;
+
+        virtual const char *kind() const = 0;
+        virtual void reset() = 0;
+        // the values as "key": value pairs for json / key,value lines for csv
+        virtual void write(std::ostream &out, bool json) const = 0;
+    };
+
+    class Counter : public Stat {
+    public:
+        using Stat::Stat;
+
+        void add(std::int64_t n) { total.fetch_add(n, std::memory_order_relaxed); }
+        std::int64_t value() const { return total.load(std::memory_order_relaxed); }
+
+        const char *kind() const override { return "counter"; }
+        void reset() override;
+        void write(std::ostream &out, bool json) const override;
+
+    private:
+        std::atomic<std::int64_t> total{0};
+    };
+
+    // how many times a phase ran and how long it took altogether, and at most
+    class Timer : public Stat {
+    public:
+        using Stat::Stat;
+
+        void add(std::int64_t nanoseconds);
+
+        const char *kind() const override { return "timer"; }
+        void reset() override;
+        void write(std::ostream &out, bool json) const override;
+
+    private:
+        std::atomic<std::int64_t> calls{0}, total{0}, longest{0};
+    };
+
+    // times the scope it's in
+    class Phase {
+    public:
+        explicit Phase(Timer &timer_) : timer(timer_), start(std::chrono::steady_clock::now()) {}
+        ~Phase() {
+            timer.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                              .count());
+        }
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+    private:
+        Timer &timer;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /*
+     * values bucketed by powers of 2: bucket 0 has everything below 1 (including 0 and negatives), bucket b has
+     * [2^(b-1), 2^b), and the last one everything bigger. also keeps the count, sum, min and max
+     */
+    class Histogram : public Stat {
+    public:
+        static const int numBuckets = 64;
+
+        using Stat::Stat;
+
+        void record(double value);
+
+        const char *kind() const override { return "histogram"; }
+        void reset() override;
+        void write(std::ostream &out, bool json) const override;
+
+    private:
+        std::atomic<std::int64_t> buckets[numBuckets] = {};
+        std::atomic<std::int64_t> count{0};
+        std::atomic<double> sum{0}, min{HUGE_VAL}, max{-HUGE_VAL};
+    };
+
+    /*
+     * the stat with this name, made the first time it's asked for. they live until the program ends, so the
+     * references stay good. throws std::logic_error if the name is already used by a different kind of stat
+     */
+    Counter &counter(const char *name);
+    Timer &timer(const char *name);
+    Histogram &histogram(const char *name);
+
+    /*
+     * events are for things worth seeing one at a time, like how far KMeans' centroids moved each iteration or
+     * Trainer's loss after every epoch. they go to the listener if there is one (nothing happens otherwise). it gets
+     * called on whatever thread the event happened on, so it has to be thread safe and quick
+     */
+    typedef void (*Listener)(const char *name, double value);
+    void setListener(Listener listener); // nullptr to stop
+    void event(const char *name, double value);
+
+    /*
+     * every stat reached so far. json is one object with a member per stat, csv is name,kind,key,value lines.
+     * values that aren't finite (a histogram fed an inf or nan) are null in json, which has no inf or nan
+     */
+    void writeJSON(std::ostream &out);
+    void writeCSV(std::ostream &out);
+    void write(const std::string &path); // picks csv or json by the extension. throws std::runtime_error
+    void reset(); // zeroes everything, e.g. between benchmark runs
+}
+
+#define INSTRUMENT_CONCAT2(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT2(a, b)
+
+#ifdef CS320_INSTRUMENT
+// name has to be a string literal. adds n to the counter
+#define INSTRUMENT_COUNT(name, n)                                                  \
+    do {                                                                           \
+        static instrument::Counter &instrumentCounter = instrument::counter(name); \
+        instrumentCounter.add(n);                                                  \
+    } while (0)
+// times the rest of the scope
+#define INSTRUMENT_PHASE(name)                                                                        \
+    static instrument::Timer &INSTRUMENT_CONCAT(instrumentTimer, __LINE__) = instrument::timer(name); \
+    instrument::Phase INSTRUMENT_CONCAT(instrumentPhase, __LINE__)(INSTRUMENT_CONCAT(instrumentTimer, __LINE__))
+// adds value to the histogram
+#define INSTRUMENT_RECORD(name, value)                                                   \
+    do {                                                                                 \
+        static instrument::Histogram &instrumentHistogram = instrument::histogram(name); \
+        instrumentHistogram.record(value);                                               \
+    } while (0)
+// calls the listener, if there is one
+#define INSTRUMENT_EVENT(name, value) instrument::event(name, value)
+#else
+#define INSTRUMENT_COUNT(name, n) ((void) 0)
+#define INSTRUMENT_PHASE(name) ((void) 0)
+#define INSTRUMENT_RECORD(name, value) ((void) 0)
+#define INSTRUMENT_EVENT(name, value) ((void) 0)
+#endif
@@ -0,0 +1,61 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mappedfile.h"
+
+MappedFile::MappedFile(const std::string &path, Access access) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open " + path + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error("can't stat " + path + ": " + std::strerror(err));
+    }
+    length = info.st_size;
+    // mmap of 0 bytes fails, an empty file is just an empty mapping
+    if (length > 0) {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("can't map " + path + ": " + std::strerror(err));
+        }
+        if (access == Access::Sequential) {
+            madvise(mapped, length, MADV_SEQUENTIAL); // just a hint, fine if it doesn't work
+        }
+        ptr = static_cast<const char *>(mapped);
+    }
+    close(fd); // the mapping keeps its own reference to the file
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        ptr = std::exchange(other.ptr, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::unmap() {
+    if (ptr != nullptr) {
+        munmap(const_cast<char *>(ptr), length);
+        ptr = nullptr;
+        length = 0;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+ * read only memory mapping of a whole file, shared by clustering (csv parsing) and neuralNets (model files). the
+ * pages get loaded lazily by the os, so "opening" a huge file is instant and it can be read in place without
+ * copying it into a buffer first. the pages are shared with every other process mapping the same file, so they're
+ * only paid for once per machine.
+ * move only, the mapping goes away with the object
+ */
+class MappedFile {
+public:
+    // tells the os how the pages will be read, so it can read ahead (and drop them) accordingly
+    enum class Access {
+        Sequential, // front to back once, like a file being parsed
+        Normal // anywhere, over and over, like a model's weights
+    };
+
+    MappedFile() = default;
+    // throws std::runtime_error if it can't be opened or mapped
+    explicit MappedFile(const std::string &path, Access access = Access::Sequential);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    const char *data() const { return ptr; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+private:
+    void unmap();
+
+    const char *ptr = nullptr;
+    std::size_t length = 0;
+};
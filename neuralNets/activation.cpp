@@ -0,0 +1,173 @@
+#include "activation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+/*
+ * e^x without branches or calls, so loops over it vectorize. x = k ln2 + r with |r| <= ln2 / 2, then
+ * e^x = 2^k e^r: 2^k goes straight into the exponent bits, e^r is a taylor polynomial (degree 11 for double,
+ * 7 for float, enough for a few ulp). k comes from the "add 1.5 * 2^52" trick, which leaves round(x / ln2) in the
+ * low mantissa bits without a float to int conversion (those don't vectorize before avx512)
+ */
+template <typename T>
+struct ExpTraits;
+
+template <>
+struct ExpTraits<double> {
+    typedef std::uint64_t Bits;  // unsigned, shifting the high bits out of a signed one is undefined
+    static constexpr double limit = 708;  // e^709 overflows
+    static constexpr double shifter = 6755399441055744.0;  // 1.5 * 2^52
+    static constexpr int mantissaBits = 52;
+    static constexpr Bits bias = 1023;
+    static constexpr int degree = 11;
+};
+
+template <>
+struct ExpTraits<float> {
+    typedef std::uint32_t Bits;
+    static constexpr float limit = 87;
+    static constexpr float shifter = 12582912.0f;  // 1.5 * 2^23
+    static constexpr int mantissaBits = 23;
+    static constexpr Bits bias = 127;
+    static constexpr int degree = 7;
+};
+
+template <typename T>
+inline T fastExp(T x) {
+    typedef ExpTraits<T> E;
+    const T log2e = 1.4426950408889634, ln2hi = 0.693145751953125, ln2lo = 1.4286068203094173e-06;
+    x = std::min(std::max(x, -E::limit), E::limit);
+    T shifted = x * log2e + E::shifter;
+    T k = shifted - E::shifter;
+    // ln2 in two parts so k * ln2hi is exact and r keeps its low bits
+    T r = x - k * ln2hi - k * ln2lo;
+    // 1 + r + r^2/2! + ... + r^degree/degree!, horner from the top
+    T p = 1;
+    for (int i = E::degree; i >= 1; --i) {
+        p = 1 + p * r * (T(1) / i);  // the loop unrolls, so 1 / i folds to a constant
+    }
+    typename E::Bits bits;
+    std::memcpy(&bits, &shifted, sizeof(bits));
+    // low bits of shifted are k (two's complement), the rest is the exponent/mantissa of 1.5 * 2^52, shifted out
+    bits = (bits + E::bias) << E::mantissaBits;
+    T scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// tanh from e^-2|x| so nothing cancels: |tanh x| = (1 - e^-2|x|) / (1 + e^-2|x|)
+template <typename T>
+inline T fastTanh(T x) {
+    T t = fastExp<T>(-2 * std::abs(x));
+    return std::copysign((1 - t) / (1 + t), x);
+}
+
+template <typename T>
+inline T fastSigmoid(T x) {
+    return 1 / (1 + fastExp<T>(-x));
+}
+
+template <net::Activation F, typename T>
+inline T apply(T x) {
+    switch (F) {
+        case net::Activation::Tanh:
+            return fastTanh(x);
+        case net::Activation::ReLU:
+            return x > 0 ? x : 0;
+        case net::Activation::LeakyReLU:
+            return x > 0 ? x : (T)net::leakySlope * x;
+        case net::Activation::Sigmoid:
+            return fastSigmoid(x);
+        case net::Activation::Linear:
+            return x;
+    }
+    return x;
+}
+
+// f' in terms of y = f(x)
+template <net::Activation F, typename T>
+inline T derivative(T y) {
+    switch (F) {
+        case net::Activation::Tanh:
+            return 1 - y * y;
+        case net::Activation::ReLU:
+            return y > 0 ? 1 : 0;
+        case net::Activation::LeakyReLU:
+            return y > 0 ? 1 : (T)net::leakySlope;
+        case net::Activation::Sigmoid:
+            return y * (1 - y);
+        case net::Activation::Linear:
+            return 1;
+    }
+    return 1;
+}
+
+template <net::Activation F, typename T>
+void activateRow(T *__restrict values, const T *__restrict bias, int n) {
+    for (int j = 0; j < n; ++j) {
+        values[j] = apply<F>(values[j] + bias[j]);
+    }
+}
+
+template <net::Activation F, typename T>
+void scaleRow(const T *__restrict outputs, T *__restrict deltas, int n) {
+    for (int j = 0; j < n; ++j) {
+        deltas[j] *= derivative<F>(outputs[j]);
+    }
+}
+}  // namespace
+
+std::string net::toString(Activation f) {
+    switch (f) {
+        case Activation::Tanh:
+            return "tanh";
+        case Activation::ReLU:
+            return "relu";
+        case Activation::LeakyReLU:
+            return "leaky relu";
+        case Activation::Sigmoid:
+            return "sigmoid";
+        case Activation::Linear:
+            return "linear";
+    }
+    return "?";
+}
+
+template <typename T>
+void net::activate(Activation f, T *values, const T *bias, int n) {
+    switch (f) {
+        case Activation::Tanh:
+            return activateRow<Activation::Tanh>(values, bias, n);
+        case Activation::ReLU:
+            return activateRow<Activation::ReLU>(values, bias, n);
+        case Activation::LeakyReLU:
+            return activateRow<Activation::LeakyReLU>(values, bias, n);
+        case Activation::Sigmoid:
+            return activateRow<Activation::Sigmoid>(values, bias, n);
+        case Activation::Linear:
+            return activateRow<Activation::Linear>(values, bias, n);
+    }
+}
+
+template <typename T>
+void net::scaleByDerivative(Activation f, const T *outputs, T *deltas, int n) {
+    switch (f) {
+        case Activation::Tanh:
+            return scaleRow<Activation::Tanh>(outputs, deltas, n);
+        case Activation::ReLU:
+            return scaleRow<Activation::ReLU>(outputs, deltas, n);
+        case Activation::LeakyReLU:
+            return scaleRow<Activation::LeakyReLU>(outputs, deltas, n);
+        case Activation::Sigmoid:
+            return scaleRow<Activation::Sigmoid>(outputs, deltas, n);
+        case Activation::Linear:
+            return scaleRow<Activation::Linear>(outputs, deltas, n);
+    }
+}
+
+template void net::activate<double>(Activation, double *, const double *, int);
+template void net::activate<float>(Activation, float *, const float *, int);
+template void net::scaleByDerivative<double>(Activation, const double *, double *, int);
+template void net::scaleByDerivative<float>(Activation, const float *, float *, int);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+namespace net {
+/*
+ * activation functions, picked per layer when a network is built. each one is applied a whole row at a time by a
+ * loop specialized for it (the switch happens once per row, not per neuron), and each one's derivative can be
+ * worked out from its output alone, so backprop reuses the forward pass's outputs instead of redoing tanh/exp.
+ * tanh and sigmoid use a branch free exp that the compiler vectorizes. it's within 1e-14 (double) / 1e-6 (float)
+ * of std::tanh and 1 / (1 + std::exp(-x)) everywhere (bench_activation checks)
+ */
+enum class Activation {
+    Tanh,  // what Network uses
+    ReLU,
+    LeakyReLU,  // slope leakySlope below 0
+    Sigmoid,
+    Linear
+};
+
+const double leakySlope = 0.01;
+
+std::string toString(Activation f);
+
+// values[j] = f(values[j] + bias[j]) for j < n
+template <typename T>
+void activate(Activation f, T *values, const T *bias, int n);
+
+// deltas[j] *= f'(x), where outputs[j] = f(x)
+template <typename T>
+void scaleByDerivative(Activation f, const T *outputs, T *deltas, int n);
+}  // namespace net
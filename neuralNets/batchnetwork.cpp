@@ -0,0 +1,247 @@
+#include "batchnetwork.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+void net::Gradients::add(const Gradients &other) {
+    for (int i = 0; i < weights.size(); ++i) {
+        double *w = weights[i].data();
+        const double *o = other.weights[i].data();
+        // padding is 0 in both, so the whole buffer can be added at once
+        for (std::size_t j = 0, size = (std::size_t)weights[i].rows() * weights[i].stride(); j < size; ++j) {
+            w[j] += o[j];
+        }
+        for (int j = 0; j < biases[i].size(); ++j) {
+            biases[i][j] += other.biases[i][j];
+        }
+    }
+    samples += other.samples;
+}
+
+net::BatchNetwork::BatchNetwork(std::vector<int> &topology, double lr, unsigned seed, std::vector<Activation> activations) {
+    learningRate = lr;
+    sizes = topology;
+    functions = activations.empty() ? std::vector<Activation>(sizes.size(), Activation::Tanh) : activations;
+    if (functions.size() != sizes.size()) {
+        throw std::invalid_argument("BatchNetwork: " + std::to_string(functions.size()) + " activations for " +
+                                    std::to_string(sizes.size()) + " layers");
+    }
+    allocate();
+    for (AlignedVector<double> &b : biases) {
+        std::fill(b.begin(), b.end(), 0.01);  // same as Network
+    }
+    randomize(seed);
+}
+
+net::BatchNetwork::BatchNetwork(std::vector<int> &topology, double lr) : BatchNetwork(topology, lr, std::random_device()()) {}
+
+net::BatchNetwork::BatchNetwork(const Network &other) {
+    learningRate = other.learningRate;
+    const std::vector<Layer> &layers = other.getLayers();
+    for (const Layer &l : layers) {
+        sizes.push_back(l.size());
+    }
+    functions.assign(sizes.size(), Activation::Tanh);
+    allocate();
+    for (int i = 0; i < sizes.size(); ++i) {
+        std::fill(biases[i].begin(), biases[i].end(), other.getBiases()[i]);
+        for (int j = 0; j < sizes[i]; ++j) {
+            if (i == 0) {
+                weights[i].at(0, j) = layers[i][j].inputWeights[0];
+            } else {
+                for (int k = 0; k < sizes[i - 1]; ++k) {
+                    weights[i].at(j, k) = layers[i][j].inputWeights[k];
+                }
+            }
+        }
+    }
+}
+
+void net::BatchNetwork::allocate() {
+    weights.resize(sizes.size());
+    biases.resize(sizes.size());
+    for (int i = 0; i < sizes.size(); ++i) {
+        weights[i].resize(i == 0 ? 1 : sizes[i], i == 0 ? sizes[0] : sizes[i - 1]);
+        biases[i].assign(sizes[i], 0.0);
+    }
+}
+
+void net::BatchNetwork::randomize(unsigned seed) {
+    // same distribution Neuron uses, but one seeded generator so a seed gives the same network every time
+    std::mt19937 gen(seed);
+    std::normal_distribution<> dis(-RAND_MAX, RAND_MAX);
+    for (Matrix &w : weights) {
+        for (int r = 0; r < w.rows(); ++r) {
+            for (int c = 0; c < w.cols(); ++c) {
+                w.at(r, c) = double(dis(gen)) / RAND_MAX;
+            }
+        }
+    }
+}
+
+const net::Matrix &net::BatchNetwork::forward(const Matrix &inputs, Workspace &ws) const {
+    assert(inputs.cols() == sizes[0]);
+    int batch = inputs.rows();
+    ws.activations.resize(sizes.size());
+    ws.inputs.resize(batch, inputs.cols());
+    for (int b = 0; b < batch; ++b) {
+        std::copy(inputs.row(b), inputs.row(b) + inputs.cols(), ws.inputs.row(b));
+    }
+    for (int i = 0; i < sizes.size(); ++i) {
+        Matrix &out = ws.activations[i];
+        out.resize(batch, sizes[i]);
+        const double *bias = biases[i].data();
+        if (i == 0) {
+            // first layer: each neuron only sees its own input
+            const double *w = weights[0].row(0);
+            for (int b = 0; b < batch; ++b) {
+                const double *x = inputs.row(b);
+                double *y = out.row(b);
+                for (int j = 0; j < sizes[0]; ++j) {
+                    y[j] = x[j] * w[j];
+                }
+                activate(functions[0], y, bias, sizes[0]);
+            }
+        } else {
+            // out = prev * W^T, then bias and activation
+            const Matrix &prev = ws.activations[i - 1];
+            gemmNT(batch, sizes[i], sizes[i - 1], prev.data(), prev.stride(), weights[i].data(), weights[i].stride(),
+                   out.data(), out.stride(), false);
+            for (int b = 0; b < batch; ++b) {
+                activate(functions[i], out.row(b), bias, sizes[i]);
+            }
+        }
+    }
+    return ws.activations.back();
+}
+
+double net::BatchNetwork::gradients(const Matrix &desiredOutputs, Workspace &ws, Gradients &grads) const {
+    int last = sizes.size() - 1;
+    int batch = ws.activations[last].rows();
+    assert(desiredOutputs.rows() == batch && desiredOutputs.cols() == sizes[last]);
+    ws.deltas.resize(sizes.size());
+    grads.weights.resize(sizes.size());
+    grads.biases.resize(sizes.size());
+    grads.samples = batch;
+
+    // output error, (desired - actual) * f'. every f' comes straight from the saved outputs
+    double squaredError = 0;
+    ws.deltas[last].resize(batch, sizes[last]);
+    for (int b = 0; b < batch; ++b) {
+        const double *y = ws.activations[last].row(b), *t = desiredOutputs.row(b);
+        double *d = ws.deltas[last].row(b);
+        for (int j = 0; j < sizes[last]; ++j) {
+            squaredError += (t[j] - y[j]) * (t[j] - y[j]);
+            d[j] = t[j] - y[j];
+        }
+        scaleByDerivative(functions[last], y, d, sizes[last]);
+    }
+
+    for (int i = last; i >= 0; --i) {
+        const Matrix &delta = ws.deltas[i];
+        AlignedVector<double> &biasGrad = grads.biases[i];
+        biasGrad.assign(sizes[i], 0.0);
+        for (int b = 0; b < batch; ++b) {
+            const double *d = delta.row(b);
+            for (int j = 0; j < sizes[i]; ++j) {
+                biasGrad[j] += d[j];
+            }
+        }
+        if (i == 0) {
+            // first layer: one weight per input
+            grads.weights[0].resize(1, sizes[0]);
+            double *g = grads.weights[0].row(0);
+            std::fill(g, g + sizes[0], 0.0);
+            for (int b = 0; b < batch; ++b) {
+                const double *d = delta.row(b), *x = ws.inputs.row(b);
+                for (int j = 0; j < sizes[0]; ++j) {
+                    g[j] += d[j] * x[j];
+                }
+            }
+            break;
+        }
+        const Matrix &prev = ws.activations[i - 1];
+        // weight gradient = delta^T * prev
+        grads.weights[i].resize(sizes[i], sizes[i - 1]);
+        gemmTN(sizes[i], sizes[i - 1], batch, delta.data(), delta.stride(), prev.data(), prev.stride(),
+               grads.weights[i].data(), grads.weights[i].stride(), false);
+        // pass the error back: prevDelta = delta * W, times f' of prev
+        Matrix &prevDelta = ws.deltas[i - 1];
+        prevDelta.resize(batch, sizes[i - 1]);
+        gemmNN(batch, sizes[i - 1], sizes[i], delta.data(), delta.stride(), weights[i].data(), weights[i].stride(),
+               prevDelta.data(), prevDelta.stride(), false);
+        for (int b = 0; b < batch; ++b) {
+            scaleByDerivative(functions[i - 1], prev.row(b), prevDelta.row(b), sizes[i - 1]);
+        }
+    }
+    return squaredError;
+}
+
+void net::BatchNetwork::apply(const Gradients &grads, double rate) {
+    if (grads.samples == 0) {
+        return;
+    }
+    double scale = rate / grads.samples;
+    for (int i = 0; i < sizes.size(); ++i) {
+        double *w = weights[i].data();
+        const double *g = grads.weights[i].data();
+        for (std::size_t j = 0, size = (std::size_t)weights[i].rows() * weights[i].stride(); j < size; ++j) {
+            w[j] += scale * g[j];
+        }
+        for (int j = 0; j < sizes[i]; ++j) {
+            biases[i][j] += scale * grads.biases[i][j];
+        }
+    }
+}
+
+std::size_t net::BatchNetwork::parameterCount() const {
+    std::size_t count = 0;
+    for (int i = 0; i < sizes.size(); ++i) {
+        count += (std::size_t)weights[i].rows() * weights[i].stride() + biases[i].size();
+    }
+    return count;
+}
+
+// the weights go padding and all, so each layer is one copy
+void net::BatchNetwork::getParameters(double *out) const {
+    for (int i = 0; i < sizes.size(); ++i) {
+        out = std::copy(weights[i].data(), weights[i].data() + (std::size_t)weights[i].rows() * weights[i].stride(),
+                        out);
+        out = std::copy(biases[i].begin(), biases[i].end(), out);
+    }
+}
+
+void net::BatchNetwork::setParameters(const double *in) {
+    for (int i = 0; i < sizes.size(); ++i) {
+        std::size_t size = (std::size_t)weights[i].rows() * weights[i].stride();
+        std::copy(in, in + size, weights[i].data());
+        in += size;
+        std::copy(in, in + biases[i].size(), biases[i].begin());
+        in += biases[i].size();
+    }
+}
+
+const net::Matrix &net::BatchNetwork::feedForward(const Matrix &inputs) {
+    return forward(inputs, own);
+}
+
+void net::BatchNetwork::backProp(const Matrix &desiredOutputs) {
+    gradients(desiredOutputs, own, ownGradients);
+    apply(ownGradients, learningRate);
+}
+
+std::vector<double> net::BatchNetwork::feedForward(std::vector<double> input) {
+    singleInput.resize(1, input.size());
+    std::copy(input.begin(), input.end(), singleInput.row(0));
+    const Matrix &out = feedForward(singleInput);
+    return std::vector<double>(out.row(0), out.row(0) + out.cols());
+}
+
+void net::BatchNetwork::backProp(std::vector<double> &desiredOutput) {
+    singleOutput.resize(1, desiredOutput.size());
+    std::copy(desiredOutput.begin(), desiredOutput.end(), singleOutput.row(0));
+    backProp(singleOutput);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include "activation.h"
+#include "matrix.h"
+#include "network.h"
+
+namespace net {
+// scratch space for passes through a BatchNetwork. one per thread lets several threads use the same network
+struct Workspace {
+    Matrix inputs;
+    std::vector<Matrix> activations;  // output of each layer for the last batch
+    std::vector<Matrix> deltas;
+};
+
+// summed (not averaged) over the samples of a batch, same shapes as the network's weights and biases
+struct Gradients {
+    std::vector<Matrix> weights;
+    std::vector<AlignedVector<double>> biases;
+    int samples = 0;
+    void add(const Gradients &other);
+};
+
+/*
+ * same network as Network (first layer has one weight per input, every other layer is fully connected, tanh
+ * everywhere unless other activations are given), but each layer is one aligned weight matrix plus a bias per neuron instead of a vector of Neurons,
+ * and it works on a whole mini-batch at once: feeding forward a batch is one matrix multiply per layer.
+ * the std::vector overloads take one sample, like Network, so it can be dropped in where a Network was used.
+ * backProp here is plain gradient descent on squared error, averaged over the batch
+ */
+class BatchNetwork {
+   public:
+    // one activation per layer, or none for tanh everywhere
+    BatchNetwork(std::vector<int> &topology, double lr, unsigned seed, std::vector<Activation> activations = {});
+    BatchNetwork(std::vector<int> &topology, double lr);  // random seed and tanh, like Network
+    explicit BatchNetwork(const Network &other);         // same weights and biases as other
+    double learningRate;
+
+    // one sample per row. the result stays valid until the next feedForward
+    const Matrix &feedForward(const Matrix &inputs);
+    // one row of desired outputs per sample of the batch that was just fed forward
+    void backProp(const Matrix &desiredOutputs);
+
+    // single sample versions with the same signatures as Network's
+    std::vector<double> feedForward(std::vector<double> input);
+    void backProp(std::vector<double> &desiredOutput);
+
+    /*
+     * the pieces feedForward and backProp are made of, with the scratch space passed in so threads can share the
+     * network. forward and gradients don't change the network. gradients uses the batch ws last went forward
+     * with, overwrites grads and returns the summed squared error of that batch. apply adds
+     * rate * (grads / grads.samples) to the weights
+     */
+    const Matrix &forward(const Matrix &inputs, Workspace &ws) const;
+    double gradients(const Matrix &desiredOutputs, Workspace &ws, Gradients &grads) const;
+    void apply(const Gradients &grads, double rate);
+
+    // every weight and bias as one flat list (layer by layer, weights then biases), for keeping copies in sync
+    std::size_t parameterCount() const;
+    void getParameters(double *out) const;
+    void setParameters(const double *in);
+
+    const std::vector<int> &getTopology() const { return sizes; }
+    const std::vector<Activation> &getActivations() const { return functions; }
+    const std::vector<Matrix> &getWeights() const { return weights; }
+    const std::vector<AlignedVector<double>> &getBiases() const { return biases; }
+
+   private:
+    void allocate();
+    void randomize(unsigned seed);
+
+    std::vector<int> sizes;
+    std::vector<Activation> functions;
+    // layer 0 is 1 x sizes[0] (one weight per input), layer i is sizes[i] x sizes[i - 1]
+    std::vector<Matrix> weights;
+    std::vector<AlignedVector<double>> biases;
+    // reused from batch to batch by feedForward and backProp
+    Workspace own;
+    Gradients ownGradients;
+    Matrix singleInput, singleOutput;  // for the single sample overloads
+};
+}  // namespace net
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "benchreport.h"
+
+// same idea as clustering/bench.h: one function per bench_*.cpp, picked from the command line in benchmarks.cpp, and
+// results reported through the shared benchreport.h
+namespace bench {
+void batchNetwork(long maxN);
+void trainer(long maxN);
+void predict(long maxN);
+void modelFile(long maxN);
+void precision(long maxN);
+void activation(long maxN);
+}  // namespace bench
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "activation.h"
+#include "batchnetwork.h"
+#include "bench.h"
+#include "predictor.h"
+
+/*
+ * the vectorized activations vs the libm calls they replace: worst error over a sweep of inputs, and elements per
+ * second. then a finite difference check of BatchNetwork's gradients with each activation, and BatchNetwork vs
+ * Predictor on a net that mixes them
+ */
+namespace {
+template <typename T>
+void errorAndSpeed(const std::string &type, double bound, long n) {
+    std::vector<double> x;
+    for (double v = -30; v < 30; v += 1e-3) {
+        x.push_back(v);
+    }
+    std::vector<T> values(x.begin(), x.end()), zeros(x.size(), 0);
+    for (net::Activation f : {net::Activation::Tanh, net::Activation::Sigmoid}) {
+        std::vector<T> y = values;
+        net::activate(f, y.data(), zeros.data(), y.size());
+        double worst = 0;
+        for (int i = 0; i < x.size(); ++i) {
+            double exact = f == net::Activation::Tanh ? std::tanh(x[i]) : 1 / (1 + std::exp(-x[i]));
+            worst = std::max(worst, std::abs(y[i] - exact));
+        }
+        std::cout << net::toString(f) << " " << type << " max error=" << worst << std::endl;
+        if (worst > bound) {
+            bench::mismatch() << net::toString(f) << " " << type << " is off by more than " << bound
+                      << std::endl;
+        }
+    }
+
+    std::vector<T> row(1024), bias(1024, 0);
+    long rounds = std::max(1L, n / (long)row.size());
+    for (T &v : row) {
+        v = 0.5;
+    }
+    bench::Clock::time_point start = bench::Clock::now();
+    for (long r = 0; r < rounds; ++r) {
+        net::activate(net::Activation::Tanh, row.data(), bias.data(), row.size());
+    }
+    bench::report("activate(Tanh) " + type, rounds * row.size(), bench::secondsSince(start));
+    start = bench::Clock::now();
+    for (long r = 0; r < rounds; ++r) {
+        for (T &v : row) {
+            v = std::tanh(v);
+        }
+    }
+    bench::report("std::tanh " + type, rounds * row.size(), bench::secondsSince(start));
+}
+
+// half the squared error of network on one sample
+double loss(net::BatchNetwork &network, const net::Matrix &input, const net::Matrix &target) {
+    const net::Matrix &out = network.feedForward(input);
+    double sum = 0;
+    for (int j = 0; j < out.cols(); ++j) {
+        sum += (target.at(0, j) - out.at(0, j)) * (target.at(0, j) - out.at(0, j));
+    }
+    return sum / 2;
+}
+
+// adds h to weight (r, c) of layer i. apply is the only way to change weights, so it goes through a gradient
+void nudge(net::BatchNetwork &network, int i, int r, int c, double h) {
+    net::Gradients g;
+    g.samples = 1;
+    for (const net::Matrix &w : network.getWeights()) {
+        g.weights.emplace_back(w.rows(), w.cols());
+    }
+    for (const net::AlignedVector<double> &b : network.getBiases()) {
+        g.biases.emplace_back(b.size(), 0.0);
+    }
+    g.weights[i].at(r, c) = h;
+    network.apply(g, 1);
+}
+}  // namespace
+
+void bench::activation(long maxN) {
+    errorAndSpeed<double>("double", 1e-14, maxN * 100);
+    errorAndSpeed<float>("float", 1e-6, maxN * 100);
+
+    // gradients says which way to move the weights (minus the gradient of the loss), check it against the loss
+    std::vector<int> topology = {3, 5, 4, 2};
+    std::mt19937 gen(320);
+    std::uniform_real_distribution<double> dis(-1, 1);
+    net::Matrix input(1, topology[0]), target(1, topology.back());
+    for (int j = 0; j < topology[0]; ++j) {
+        input.at(0, j) = dis(gen);
+    }
+    for (int j = 0; j < topology.back(); ++j) {
+        target.at(0, j) = dis(gen) * 0.5;
+    }
+    for (net::Activation f : {net::Activation::Tanh, net::Activation::ReLU, net::Activation::LeakyReLU,
+                              net::Activation::Sigmoid, net::Activation::Linear}) {
+        net::BatchNetwork network(topology, 0.01, 320, std::vector<net::Activation>(topology.size(), f));
+        net::Workspace ws;
+        net::Gradients grads;
+        network.forward(input, ws);
+        network.gradients(target, ws, grads);
+        double worst = 0;
+        const double h = 1e-6;
+        for (int i = 1; i < topology.size(); ++i) {
+            for (int r = 0; r < topology[i]; ++r) {
+                for (int c = 0; c < topology[i - 1]; ++c) {
+                    nudge(network, i, r, c, h);
+                    double up = loss(network, input, target);
+                    nudge(network, i, r, c, -2 * h);
+                    double down = loss(network, input, target);
+                    nudge(network, i, r, c, h);
+                    double numeric = -(up - down) / (2 * h);
+                    worst = std::max(worst, std::abs(numeric - grads.weights[i].at(r, c)));
+                }
+            }
+        }
+        std::cout << net::toString(f) << " gradient check max difference=" << worst << std::endl;
+        if (worst > 1e-6) {
+            bench::mismatch() << net::toString(f) << " gradients are wrong" << std::endl;
+        }
+    }
+
+    std::vector<int> mixedTopology = {16, 64, 64, 64, 8};
+    std::vector<net::Activation> mixed = {net::Activation::Linear, net::Activation::ReLU, net::Activation::LeakyReLU,
+                                          net::Activation::Sigmoid, net::Activation::Tanh};
+    net::BatchNetwork network(mixedTopology, 0.01, 320, mixed);
+    net::Predictor predictor(network);
+    net::Matrix inputs(64, mixedTopology[0]), outputs;
+    for (int s = 0; s < inputs.rows(); ++s) {
+        for (int j = 0; j < inputs.cols(); ++j) {
+            inputs.at(s, j) = dis(gen);
+        }
+    }
+    net::Predictor::Scratch scratch;
+    predictor.predictBatch(inputs, outputs, scratch);
+    const net::Matrix &expected = network.feedForward(inputs);
+    double worst = 0;
+    for (int s = 0; s < inputs.rows(); ++s) {
+        for (int j = 0; j < outputs.cols(); ++j) {
+            worst = std::max(worst, std::abs(outputs.at(s, j) - expected.at(s, j)));
+        }
+    }
+    if (worst > 1e-12) {
+        bench::mismatch() << "Predictor differs from BatchNetwork by " << worst << " with mixed activations"
+                  << std::endl;
+    }
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "batchnetwork.h"
+#include "bench.h"
+#include "network.h"
+
+/*
+ * per neuron Network vs matrix BatchNetwork on wide topologies, feeding forward and training one sample at a
+ * time vs in mini-batches. also checks both engines give the same outputs for the same weights
+ */
+void bench::batchNetwork(long maxN) {
+    std::vector<std::vector<int>> topologies = {{64, 256, 10}, {256, 1024, 1024, 10}};
+    for (std::vector<int> &topology : topologies) {
+        std::string name = "";
+        for (int size : topology) {
+            name += (name.empty() ? "" : "-") + std::to_string(size);
+        }
+        std::mt19937 gen(320);
+        std::uniform_real_distribution<double> dis(-1, 1);
+        long n = std::max(64L, maxN / topology[1] * 64);  // wider nets get fewer samples so it doesn't take forever
+        std::vector<std::vector<double>> inputs(n, std::vector<double>(topology[0])), targets(n,
+                                                                                             std::vector<double>(topology.back()));
+        for (long s = 0; s < n; ++s) {
+            for (double &x : inputs[s]) {
+                x = dis(gen);
+            }
+            for (double &t : targets[s]) {
+                t = dis(gen);
+            }
+        }
+
+        net::Network perNeuron(topology, 0.01);
+        net::BatchNetwork batched(perNeuron);
+        double maxDiff = 0;
+        for (long s = 0; s < std::min(n, 100L); ++s) {
+            std::vector<double> a = perNeuron.feedForward(inputs[s]), b = batched.feedForward(inputs[s]);
+            for (int j = 0; j < a.size(); ++j) {
+                maxDiff = std::max(maxDiff, std::abs(a[j] - b[j]));
+            }
+        }
+        if (maxDiff > 1e-9) {
+            bench::mismatch() << "engines differ by " << maxDiff << " on " << name << std::endl;
+        }
+
+        Clock::time_point start = Clock::now();
+        for (long s = 0; s < n; ++s) {
+            perNeuron.feedForward(inputs[s]);
+        }
+        report("Network::feedForward " + name, n, secondsSince(start));
+        double backPropSeconds = 0;
+        start = Clock::now();
+        for (long s = 0; s < n; ++s) {
+            perNeuron.feedForward(inputs[s]);
+            Clock::time_point backPropStart = Clock::now();
+            perNeuron.backProp(targets[s]);
+            backPropSeconds += secondsSince(backPropStart);
+        }
+        report("Network train " + name, n, secondsSince(start));
+        report("Network::backProp " + name, n, backPropSeconds);
+
+        start = Clock::now();
+        for (long s = 0; s < n; ++s) {
+            batched.feedForward(inputs[s]);
+        }
+        report("BatchNetwork::feedForward batch=1 " + name, n, secondsSince(start));
+
+        for (int batchSize : {16, 64, 256}) {
+            net::Matrix in(batchSize, topology[0]), out(batchSize, topology.back());
+            long batches = n / batchSize;
+            start = Clock::now();
+            for (long bi = 0; bi < batches; ++bi) {
+                for (int b = 0; b < batchSize; ++b) {
+                    std::copy(inputs[bi * batchSize + b].begin(), inputs[bi * batchSize + b].end(), in.row(b));
+                }
+                batched.feedForward(in);
+            }
+            report("BatchNetwork::feedForward batch=" + std::to_string(batchSize) + " " + name, batches * batchSize,
+                   secondsSince(start));
+            start = Clock::now();
+            for (long bi = 0; bi < batches; ++bi) {
+                for (int b = 0; b < batchSize; ++b) {
+                    std::copy(inputs[bi * batchSize + b].begin(), inputs[bi * batchSize + b].end(), in.row(b));
+                    std::copy(targets[bi * batchSize + b].begin(), targets[bi * batchSize + b].end(), out.row(b));
+                }
+                batched.feedForward(in);
+                batched.backProp(out);
+            }
+            report("BatchNetwork train batch=" + std::to_string(batchSize) + " " + name, batches * batchSize,
+                   secondsSince(start));
+        }
+    }
+}
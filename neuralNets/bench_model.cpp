@@ -0,0 +1,160 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "batchnetwork.h"
+#include "bench.h"
+#include "predictor.h"
+
+/*
+ * saves a big model and compares ways of getting to the first prediction: copying the weights out of a network
+ * in memory, reading the file into a buffer (what parsing any format costs at least), and Predictor::load.
+ * then forks a few worker processes that all load the same file and reports how much of the model's memory each
+ * one actually pays for (Pss) vs how much it touches (Rss).
+ * the file is in the page cache for all of this, since it was just written. the benchmark process keeps its own
+ * mapping open too, so Pss is split workers + 1 ways
+ */
+
+namespace {
+// Rss and Pss (kB) of this process's mapping of path, from /proc/self/smaps
+void mappingMemory(const std::string &path, long &rss, long &pss) {
+    rss = pss = 0;
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inMapping = false;
+    while (std::getline(smaps, line)) {
+        std::istringstream words(line);
+        std::string first;
+        words >> first;
+        if (first.back() != ':') {
+            // a mapping header: "start-end perms offset dev inode path"
+            inMapping = line.size() >= path.size() && line.compare(line.size() - path.size(), path.size(), path) == 0;
+        } else if (inMapping && first == "Rss:") {
+            long kb;
+            words >> kb;
+            rss += kb;
+        } else if (inMapping && first == "Pss:") {
+            long kb;
+            words >> kb;
+            pss += kb;
+        }
+    }
+}
+}  // namespace
+
+void bench::modelFile(long maxN) {
+    std::vector<int> topology = {256, 1024, 1024, 10};
+    net::BatchNetwork network(topology, 0.01, 320);
+    std::string path = tempPath("bench_model.bin");
+
+    Clock::time_point start = Clock::now();
+    net::Predictor inMemory(network);
+    double copySeconds = secondsSince(start);
+    start = Clock::now();
+    inMemory.save(path);
+    report("Predictor::save", 1, secondsSince(start));
+
+    std::vector<double> input(topology[0]), expected(topology.back()), output(topology.back());
+    std::mt19937 gen(320);
+    std::uniform_real_distribution<double> dis(-1, 1);
+    for (double &x : input) {
+        x = dis(gen);
+    }
+    inMemory.predict(input.data(), expected.data());
+
+    std::cout << "copy weights from a network: " << copySeconds * 1e3 << "ms" << std::endl;
+    start = Clock::now();
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> buffer(std::filesystem::file_size(path));
+        in.read(buffer.data(), buffer.size());
+    }
+    std::cout << "read the file into memory: " << secondsSince(start) * 1e3 << "ms" << std::endl;
+    start = Clock::now();
+    net::Predictor loaded = net::Predictor::load(path);
+    double loadSeconds = secondsSince(start);
+    loaded.predict(input.data(), output.data());
+    std::cout << "Predictor::load: " << loadSeconds * 1e3 << "ms, first prediction after "
+              << secondsSince(start) * 1e3 << "ms" << std::endl;
+    if (output != expected) {
+        bench::mismatch() << "loaded model predicts differently" << std::endl;
+    }
+
+    // a cut off file has to be rejected, not read past the end of. so does one with layer sizes that would wrap
+    // around an int, or add up to more than the file holds (the u32 layer sizes start 32 bytes in)
+    std::vector<char> contents(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(contents.data(), contents.size());
+    std::string corrupt = tempPath("bench_model_corrupt.bin");
+    for (std::uint32_t bogus : {0u, 0xFFFFFFFFu, 0x7FFFFF00u}) {
+        std::vector<char> broken = contents;
+        if (bogus == 0) {
+            broken.resize(broken.size() / 2);
+        } else {
+            for (int layer = 1; layer < 3; ++layer) {
+                std::memcpy(broken.data() + 32 + layer * sizeof(bogus), &bogus, sizeof(bogus));
+            }
+        }
+        std::ofstream(corrupt, std::ios::binary).write(broken.data(), broken.size());
+        try {
+            net::Predictor::load(corrupt);
+            bench::mismatch() << (bogus == 0 ? "truncated" : "corrupt") << " model file loaded" << std::endl;
+        } catch (const std::runtime_error &) {
+        }
+    }
+    std::remove(corrupt.c_str());
+
+    // workers load the model, run over every weight, then wait until they've all got it mapped before measuring
+    const int workers = 4;
+    int ready[2], go[2], results[2];
+    if (pipe(ready) != 0 || pipe(go) != 0 || pipe(results) != 0) {
+        std::cout << "can't make pipes, skipping the multi process part" << std::endl;
+        std::remove(path.c_str());
+        return;
+    }
+    std::vector<pid_t> children;
+    for (int w = 0; w < workers; ++w) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            net::Predictor model = net::Predictor::load(path);
+            std::vector<double> out(topology.back());
+            model.predict(input.data(), out.data());
+            char byte = 1;
+            write(ready[1], &byte, 1);
+            read(go[0], &byte, 1);
+            long mem[2];
+            mappingMemory(path, mem[0], mem[1]);
+            write(results[1], mem, sizeof(mem));
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    char byte;
+    for (int w = 0; w < workers; ++w) {
+        read(ready[0], &byte, 1);
+    }
+    std::vector<char> goBytes(workers, 1);
+    write(go[1], goBytes.data(), workers);
+    long totalRss = 0, totalPss = 0;
+    for (int w = 0; w < workers; ++w) {
+        long mem[2];
+        read(results[0], mem, sizeof(mem));
+        totalRss += mem[0];
+        totalPss += mem[1];
+    }
+    for (pid_t pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+    for (int fd : {ready[0], ready[1], go[0], go[1], results[0], results[1]}) {
+        close(fd);
+    }
+    std::cout << workers << " workers sharing a " << (std::filesystem::file_size(path) >> 10) << "kB model: Rss "
+              << totalRss / workers << "kB each, Pss " << totalPss / workers << "kB each, " << totalPss
+              << "kB total" << std::endl;
+    std::remove(path.c_str());
+}
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "batchnetwork.h"
+#include "bench.h"
+#include "predictor.h"
+
+/*
+ * accuracy vs throughput of the inference precisions, to pick the cheapest one inside an error budget.
+ * error is against the double model on the same inputs. Network's weight init (mean -1, sd 1) saturates nearly
+ * every tanh past the first layer, and a net that only outputs +-1 hides any rounding error, so the weights are
+ * scaled down by sqrt(fan in) first, which is closer to what a trained net looks like.
+ * each precision has a mean error budget. int8's (0.05 on outputs in [-1, 1]) is a few times what it gets now
+ * (0.006 to 0.015), so a rounding or scaling bug in the quantization goes over it while a tweak doesn't
+ */
+namespace {
+template <typename T>
+void measure(const std::string &name, const net::BasicPredictor<T> &model, const net::Matrix &inputs,
+             const net::Matrix &expected, double meanBudget) {
+    typename net::BasicPredictor<T>::Scratch scratch;
+    net::Matrix outputs;
+    model.predictBatch(inputs, outputs, scratch);
+    double maxError = 0, sumError = 0;
+    for (int s = 0; s < inputs.rows(); ++s) {
+        for (int j = 0; j < outputs.cols(); ++j) {
+            double error = std::abs(outputs.at(s, j) - expected.at(s, j));
+            maxError = std::max(maxError, error);
+            sumError += error;
+        }
+    }
+    double meanError = sumError / ((double)inputs.rows() * outputs.cols());
+    std::cout << "  " << name << " " << (model.bytes() >> 10) << "kB max error=" << maxError
+              << " mean error=" << meanError << std::endl;
+    if (meanError > meanBudget) {
+        bench::mismatch() << name << " mean error " << meanError << " is over its budget of " << meanBudget
+                  << std::endl;
+    }
+
+    std::vector<double> out(model.outputSize());
+    bench::Clock::time_point start = bench::Clock::now();
+    for (int s = 0; s < inputs.rows(); ++s) {
+        model.predict(inputs.row(s), out.data(), scratch);
+    }
+    bench::report("    batch=1", inputs.rows(), bench::secondsSince(start));
+    const int batchSize = 64;
+    net::Matrix batchOut(batchSize, model.outputSize());
+    start = bench::Clock::now();
+    int done = 0;
+    for (; done + batchSize <= inputs.rows(); done += batchSize) {
+        model.predictBatch(inputs.row(done), batchSize, inputs.stride(), batchOut.data(), batchOut.stride(), scratch);
+    }
+    bench::report("    batch=64", done, bench::secondsSince(start));
+}
+}  // namespace
+
+void bench::precision(long maxN) {
+    std::vector<std::vector<int>> topologies = {{64, 256, 256, 10}, {256, 1024, 1024, 10}};
+    for (std::vector<int> &topology : topologies) {
+        std::string name = "";
+        for (int size : topology) {
+            name += (name.empty() ? "" : "-") + std::to_string(size);
+        }
+        int n = std::max(256L, maxN / topology[1] * 64);
+        std::mt19937 gen(320);
+        std::uniform_real_distribution<double> dis(-1, 1);
+        net::Matrix inputs(n, topology[0]);
+        for (int s = 0; s < n; ++s) {
+            for (int j = 0; j < topology[0]; ++j) {
+                inputs.at(s, j) = dis(gen);
+            }
+        }
+        net::BatchNetwork network(topology, 0.01, 320);
+        // apply adds rate * grads / samples, so "gradients" of w * (scale - 1) turn every w into w * scale
+        net::Gradients rescale;
+        rescale.samples = 1;
+        for (int i = 0; i < topology.size(); ++i) {
+            const net::Matrix &w = network.getWeights()[i];
+            double scale = 1 / std::sqrt(i == 0 ? 1.0 : topology[i - 1]);
+            rescale.weights.emplace_back(w.rows(), w.cols());
+            for (int r = 0; r < w.rows(); ++r) {
+                for (int c = 0; c < w.cols(); ++c) {
+                    rescale.weights[i].at(r, c) = w.at(r, c) * (scale - 1);
+                }
+            }
+            rescale.biases.emplace_back(topology[i], 0.0);
+        }
+        network.apply(rescale, 1);
+        net::Predictor full(network);
+        net::Predictor::Scratch scratch;
+        net::Matrix expected;
+        full.predictBatch(inputs, expected, scratch);
+
+        std::cout << name << ":" << std::endl;
+        measure("float64", full, inputs, expected, 0);
+        measure("float32", net::FloatPredictor::convert(full), inputs, expected, 1e-6);
+        measure("int8", net::Int8Predictor::convert(full), inputs, expected, 0.05);
+    }
+}
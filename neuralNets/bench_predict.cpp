@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <thread>
+#include "bench.h"
+#include "network.h"
+#include "predictor.h"
+
+/*
+ * per call latency of single sample inference: Network::feedForward vs Predictor::predict, then Predictor from
+ * several threads at once sharing one model. reports p50/p99 per call.
+ * also checks Predictor gives Network's outputs and that it doesn't allocate once warmed up
+ */
+
+// counts every heap allocation in the benchmarks binary. replacing the global operator new is the only way to see
+// allocations made inside the standard library too
+namespace {
+std::atomic<long> allocations(0);
+}  // namespace
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = (std::size_t)align;
+    if (void *p = std::aligned_alloc(a, (size + a - 1) / a * a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+// sorts latencies (in seconds) and prints the median and 99th percentile in microseconds
+void reportLatency(const std::string &name, std::vector<double> &latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, (std::size_t)(p * latencies.size()))]; };
+    std::cout << name << " calls=" << latencies.size() << " p50=" << percentile(0.5) * 1e6
+              << "us p99=" << percentile(0.99) * 1e6 << "us" << std::endl;
+}
+}  // namespace
+
+void bench::predict(long maxN) {
+    std::vector<std::vector<int>> topologies = {{16, 64, 4}, {64, 256, 256, 10}};
+    for (std::vector<int> &topology : topologies) {
+        std::string name = "";
+        for (int size : topology) {
+            name += (name.empty() ? "" : "-") + std::to_string(size);
+        }
+        long n = std::max(1000L, maxN);
+        std::mt19937 gen(320);
+        std::uniform_real_distribution<double> dis(-1, 1);
+        net::Matrix inputs(n, topology[0]);
+        for (long s = 0; s < n; ++s) {
+            for (int j = 0; j < topology[0]; ++j) {
+                inputs.at(s, j) = dis(gen);
+            }
+        }
+
+        net::Network network(topology, 0.01);
+        net::Predictor predictor(network);
+        std::vector<double> output(topology.back());
+        double maxDiff = 0;
+        for (long s = 0; s < std::min(n, 100L); ++s) {
+            std::vector<double> expected = network.feedForward(std::vector<double>(inputs.row(s), inputs.row(s) + topology[0]));
+            predictor.predict(inputs.row(s), output.data());
+            for (int j = 0; j < output.size(); ++j) {
+                maxDiff = std::max(maxDiff, std::abs(expected[j] - output[j]));
+            }
+        }
+        if (maxDiff > 1e-9) {
+            bench::mismatch() << "Predictor differs from Network by " << maxDiff << " on " << name << std::endl;
+        }
+
+        std::vector<double> latencies(n);
+        std::vector<double> input(topology[0]);
+        for (long s = 0; s < n; ++s) {
+            std::copy(inputs.row(s), inputs.row(s) + topology[0], input.begin());
+            Clock::time_point start = Clock::now();
+            network.feedForward(input);
+            latencies[s] = secondsSince(start);
+        }
+        reportLatency("Network::feedForward " + name, latencies);
+
+        net::Predictor::Scratch scratch;
+        predictor.reserve(scratch, 1);
+        long allocationsBefore = allocations.load();
+        for (long s = 0; s < n; ++s) {
+            Clock::time_point start = Clock::now();
+            predictor.predict(inputs.row(s), output.data(), scratch);
+            latencies[s] = secondsSince(start);
+        }
+        long allocated = allocations.load() - allocationsBefore;
+        reportLatency("Predictor::predict " + name, latencies);
+        if (allocated != 0) {
+            bench::mismatch() << "Predictor::predict allocated " << allocated << " times after warm up" << std::endl;
+        }
+
+        // everyone hammering the same predictor, each with its own scratch and latency list
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        for (int threads = 2; threads <= std::max(cores, 2); threads *= 2) {
+            std::vector<std::vector<double>> perThread(threads, std::vector<double>(n / threads));
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    net::Predictor::Scratch own;
+                    std::vector<double> out(topology.back());
+                    predictor.reserve(own, 1);
+                    for (long s = 0; s < perThread[t].size(); ++s) {
+                        Clock::time_point start = Clock::now();
+                        predictor.predict(inputs.row(t + s * threads), out.data(), own);
+                        perThread[t][s] = secondsSince(start);
+                    }
+                });
+            }
+            for (std::thread &w : workers) {
+                w.join();
+            }
+            std::vector<double> all;
+            for (std::vector<double> &l : perThread) {
+                all.insert(all.end(), l.begin(), l.end());
+            }
+            reportLatency("Predictor::predict " + std::to_string(threads) + " threads " + name, all);
+        }
+
+        for (int batchSize : {16, 256}) {
+            net::Matrix out(batchSize, topology.back());
+            long batches = n / batchSize;
+            latencies.resize(batches);
+            for (long bi = 0; bi < batches; ++bi) {
+                Clock::time_point start = Clock::now();
+                predictor.predictBatch(inputs.row(bi * batchSize), batchSize, inputs.stride(), out.data(), out.stride(),
+                                       scratch);
+                latencies[bi] = secondsSince(start);
+            }
+            reportLatency("Predictor::predictBatch batch=" + std::to_string(batchSize) + " " + name, latencies);
+        }
+    }
+}
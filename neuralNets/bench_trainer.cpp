@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "batchnetwork.h"
+#include "bench.h"
+#include "trainer.h"
+
+/*
+ * data parallel training at 1, 2, 4, ... threads in both modes. reports samples/second and scaling efficiency
+ * (speedup over 1 thread / threads), and checks synchronous mode gives the same result twice from the same seed,
+ * and that Hogwild on one thread gives the same weights as synchronous
+ */
+void bench::trainer(long maxN) {
+    std::vector<int> topology = {64, 256, 256, 10};
+    int n = std::max(256L, maxN);
+    // targets come from a fixed random "teacher" so there's something to learn
+    std::mt19937 gen(320);
+    std::uniform_real_distribution<double> dis(-1, 1);
+    net::Matrix inputs(n, topology[0]), targets(n, topology.back());
+    std::vector<double> teacher(topology[0] * topology.back());
+    for (double &w : teacher) {
+        w = dis(gen) * 0.3;
+    }
+    for (int s = 0; s < n; ++s) {
+        for (int j = 0; j < topology[0]; ++j) {
+            inputs.at(s, j) = dis(gen);
+        }
+        for (int o = 0; o < topology.back(); ++o) {
+            double sum = 0;
+            for (int j = 0; j < topology[0]; ++j) {
+                sum += teacher[o * topology[0] + j] * inputs.at(s, j);
+            }
+            targets.at(s, o) = std::tanh(sum);
+        }
+    }
+
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (net::Trainer::Mode mode : {net::Trainer::Mode::Synchronous, net::Trainer::Mode::Hogwild}) {
+        std::string name = mode == net::Trainer::Mode::Synchronous ? "sync" : "hogwild";
+        double baseRate = 0;
+        for (int threads = 1; threads <= std::max(cores, 2); threads *= 2) {
+            net::BatchNetwork network(topology, 0.01, 320);
+            net::Trainer trainer(network, threads, mode);
+            const int epochs = 3;
+            double error = 0;
+            Clock::time_point start = Clock::now();
+            for (int e = 0; e < epochs; ++e) {
+                error = trainer.trainEpoch(inputs, targets);
+            }
+            double seconds = secondsSince(start);
+            report("train " + name + " " + std::to_string(threads) + " threads", (long)n * epochs, seconds);
+            double rate = n * epochs / seconds;
+            if (threads == 1) {
+                baseRate = rate;
+            }
+            std::cout << "    efficiency=" << rate / baseRate / threads << " last epoch mse=" << error << std::endl;
+        }
+    }
+
+    // same seed, same threads, same everything -> same weights, so the same error on the next epoch
+    double errors[2];
+    for (double &error : errors) {
+        net::BatchNetwork network(topology, 0.01, 320);
+        net::Trainer trainer(network, 2, net::Trainer::Mode::Synchronous);
+        trainer.trainEpoch(inputs, targets);
+        error = trainer.trainEpoch(inputs, targets);
+    }
+    if (errors[0] != errors[1]) {
+        bench::mismatch() << "synchronous training isn't deterministic" << std::endl;
+    }
+
+    // on one thread nothing races, so Hogwild's merge into the shared weights has to reproduce Synchronous exactly
+    std::vector<double> weights[2];
+    for (net::Trainer::Mode mode : {net::Trainer::Mode::Synchronous, net::Trainer::Mode::Hogwild}) {
+        net::BatchNetwork network(topology, 0.01, 320);
+        net::Trainer trainer(network, 1, mode);
+        trainer.trainEpoch(inputs, targets);
+        std::vector<double> &w = weights[mode == net::Trainer::Mode::Hogwild];
+        w.resize(network.parameterCount());
+        network.getParameters(w.data());
+    }
+    if (weights[0] != weights[1]) {
+        bench::mismatch() << "one thread of hogwild doesn't train like synchronous" << std::endl;
+    }
+}
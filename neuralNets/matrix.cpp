@@ -0,0 +1,176 @@
+#include "matrix.h"
+#include <algorithm>
+
+net::Matrix::Matrix(int rows_, int cols_) {
+    resize(rows_, cols_);
+}
+
+void net::Matrix::resize(int rows_, int cols_) {
+    if (rows_ == numRows && cols_ == numCols) {
+        return;
+    }
+    numRows = rows_;
+    numCols = cols_;
+    rowStride = (cols_ + 7) / 8 * 8;
+    values.assign((std::size_t)numRows * rowStride, 0.0);
+}
+
+namespace {
+// sizes of the blocks of k and n worked on at once, so the rows of B being reused stay in L1/L2
+const int kBlock = 256;
+const int nBlock = 512;
+
+/*
+ * C (+)= op(A) * B, where op(A)(i, p) is A[i * lda + p], or A[p * lda + i] when transposed.
+ * four rows of C at a time, so every value loaded from B gets used four times. the innermost loop walks a row of B
+ * and C with unit stride, which the compiler turns into simd
+ */
+template <bool transA>
+void gemmKernel(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+                bool accumulate) {
+    auto a = [&](int i, int p) { return transA ? A[(std::size_t)p * lda + i] : A[(std::size_t)i * lda + p]; };
+    if (!accumulate) {
+        for (int i = 0; i < m; ++i) {
+            std::fill(C + (std::size_t)i * ldc, C + (std::size_t)i * ldc + n, 0.0);
+        }
+    }
+    for (int kk = 0; kk < k; kk += kBlock) {
+        int kEnd = std::min(k, kk + kBlock);
+        for (int jj = 0; jj < n; jj += nBlock) {
+            int jEnd = std::min(n, jj + nBlock);
+            int i = 0;
+            for (; i + 4 <= m; i += 4) {
+                double *__restrict c0 = C + (std::size_t)i * ldc;
+                double *__restrict c1 = c0 + ldc;
+                double *__restrict c2 = c1 + ldc;
+                double *__restrict c3 = c2 + ldc;
+                for (int p = kk; p < kEnd; ++p) {
+                    double a0 = a(i, p), a1 = a(i + 1, p), a2 = a(i + 2, p), a3 = a(i + 3, p);
+                    const double *__restrict b = B + (std::size_t)p * ldb;
+                    for (int j = jj; j < jEnd; ++j) {
+                        double bj = b[j];
+                        c0[j] += a0 * bj;
+                        c1[j] += a1 * bj;
+                        c2[j] += a2 * bj;
+                        c3[j] += a3 * bj;
+                    }
+                }
+            }
+            for (; i < m; ++i) {
+                double *__restrict c = C + (std::size_t)i * ldc;
+                for (int p = kk; p < kEnd; ++p) {
+                    double ai = a(i, p);
+                    const double *__restrict b = B + (std::size_t)p * ldb;
+                    for (int j = jj; j < jEnd; ++j) {
+                        c[j] += ai * b[j];
+                    }
+                }
+            }
+        }
+    }
+}
+}  // namespace
+
+void net::gemmNN(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+                 bool accumulate) {
+    gemmKernel<false>(m, n, k, A, lda, B, ldb, C, ldc, accumulate);
+}
+
+void net::gemmTN(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+                 bool accumulate) {
+    gemmKernel<true>(m, n, k, A, lda, B, ldb, C, ldc, accumulate);
+}
+
+namespace {
+/*
+ * C (+)= A * B^T for double or float. every entry of C is a dot product of a row of A and a row of B, both
+ * contiguous. 2 rows of A x 4 rows of B at a time, with 32 byte simd vectors of partial sums per dot product
+ * (gcc/clang vector extensions)
+ */
+template <typename T>
+void gemmNTKernel(int m, int n, int k, const T *A, int lda, const T *B, int ldb, T *C, int ldc, bool accumulate) {
+    const int lanes = 32 / sizeof(T);
+    typedef T vec __attribute__((vector_size(32)));
+    int kv = k / lanes * lanes;
+    for (int i = 0; i < m; i += 2) {
+        int rowsA = std::min(2, m - i);
+        const T *a0 = A + (std::size_t)i * lda, *a1 = rowsA == 2 ? a0 + lda : a0;
+        for (int j = 0; j < n; j += 4) {
+            int rowsB = std::min(4, n - j);
+            const T *b[4];
+            for (int r = 0; r < 4; ++r) {
+                b[r] = B + (std::size_t)(j + std::min(r, rowsB - 1)) * ldb;  // repeat the last row past the end
+            }
+            vec s[2][4] = {};
+            for (int p = 0; p < kv; p += lanes) {
+                vec x0, x1, y;  // memcpy = unaligned load
+                __builtin_memcpy(&x0, a0 + p, sizeof(vec));
+                __builtin_memcpy(&x1, a1 + p, sizeof(vec));
+                for (int r = 0; r < 4; ++r) {
+                    __builtin_memcpy(&y, b[r] + p, sizeof(vec));
+                    s[0][r] += x0 * y;
+                    s[1][r] += x1 * y;
+                }
+            }
+            for (int ii = 0; ii < rowsA; ++ii) {
+                const T *a = ii == 0 ? a0 : a1;
+                T *c = C + (std::size_t)(i + ii) * ldc + j;
+                for (int r = 0; r < rowsB; ++r) {
+                    // add neighbouring lanes pairwise, ((0 + 1) + (2 + 3)) + ...
+                    T sums[lanes];
+                    __builtin_memcpy(sums, &s[ii][r], sizeof(vec));
+                    for (int width = 1; width < lanes; width *= 2) {
+                        for (int l = 0; l < lanes; l += 2 * width) {
+                            sums[l] += sums[l + width];
+                        }
+                    }
+                    T dot = sums[0];
+                    for (int p = kv; p < k; ++p) {
+                        dot += a[p] * b[r][p];
+                    }
+                    c[r] = accumulate ? c[r] + dot : dot;
+                }
+            }
+        }
+    }
+}
+}  // namespace
+
+void net::gemmNT(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+                 bool accumulate) {
+    gemmNTKernel(m, n, k, A, lda, B, ldb, C, ldc, accumulate);
+}
+
+void net::gemmNT(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc,
+                 bool accumulate) {
+    gemmNTKernel(m, n, k, A, lda, B, ldb, C, ldc, accumulate);
+}
+
+void net::gemmNT(int m, int n, int k, const std::int8_t *A, int lda, const std::int8_t *B, int ldb, std::int32_t *C,
+                 int ldc, bool accumulate) {
+    // 4 rows of B per row of A. plain loops widening to 32 bits, which the compiler vectorizes into multiply-adds of
+    // 8 bit pairs (vpmaddubsw/vpmaddwd, or vpdpbusd with avx512 vnni). integer sums, so the order doesn't matter
+    for (int i = 0; i < m; ++i) {
+        const std::int8_t *a = A + (std::size_t)i * lda;
+        std::int32_t *c = C + (std::size_t)i * ldc;
+        for (int j = 0; j < n; j += 4) {
+            int rowsB = std::min(4, n - j);
+            const std::int8_t *b[4];
+            for (int r = 0; r < 4; ++r) {
+                b[r] = B + (std::size_t)(j + std::min(r, rowsB - 1)) * ldb;
+            }
+            std::int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            for (int p = 0; p < k; ++p) {
+                std::int32_t x = a[p];
+                s0 += x * b[0][p];
+                s1 += x * b[1][p];
+                s2 += x * b[2][p];
+                s3 += x * b[3][p];
+            }
+            std::int32_t sums[4] = {s0, s1, s2, s3};
+            for (int r = 0; r < rowsB; ++r) {
+                c[j + r] = accumulate ? c[j + r] + sums[r] : sums[r];
+            }
+        }
+    }
+}
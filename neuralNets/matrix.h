@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace net {
+// hands out memory aligned to Alignment bytes, so simd loads of a row never straddle a cache line boundary
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T *p, std::size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// row major. rows are padded to a multiple of 8 doubles so each one starts 64 byte aligned. padding stays 0
+class Matrix {
+   public:
+    Matrix() = default;
+    Matrix(int rows_, int cols_);
+    // does nothing if the shape is the same, so resizing a buffer every batch is free. otherwise zeroes it
+    void resize(int rows_, int cols_);
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    int stride() const { return rowStride; }
+    double *data() { return values.data(); }
+    const double *data() const { return values.data(); }
+    double *row(int i) { return values.data() + (std::size_t)i * rowStride; }
+    const double *row(int i) const { return values.data() + (std::size_t)i * rowStride; }
+    double &at(int i, int j) { return row(i)[j]; }
+    double at(int i, int j) const { return row(i)[j]; }
+
+   private:
+    int numRows = 0, numCols = 0, rowStride = 0;
+    AlignedVector<double> values;
+};
+
+/*
+ * blocked matrix multiplies. all matrices row major with leading dimension (row stride) ld*.
+ * C is m x n. if accumulate is false C is overwritten, otherwise the product is added to it
+ */
+void gemmNN(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+            bool accumulate);  // C = A (m x k) * B (k x n)
+void gemmTN(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+            bool accumulate);  // C = A^T * B, A is k x m
+void gemmNT(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc,
+            bool accumulate);  // C = A * B^T, B is n x k
+// lower precision versions of gemmNT for inference. the int8 one sums exactly into 32 bit ints
+void gemmNT(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc, bool accumulate);
+void gemmNT(int m, int n, int k, const std::int8_t *A, int lda, const std::int8_t *B, int ldb, std::int32_t *C,
+            int ldc, bool accumulate);
+}  // namespace net
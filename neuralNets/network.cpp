@@ -3,6 +3,7 @@
 #include <cmath>
 #include <iostream>
 #include <random>
+#include "instrument.h"
 
 // changed to tanh because ReLU was being annoying
 // didn't bother to refactor naming because VS code is 🅱️ad
@@ -14,7 +15,8 @@ double net::ReLU(double x) {
 
 double net::dReLU(double x) {
     // return x > 0 ? 1 : 0;
-    return 1 - pow(tanh(x), 2);
+    double t = tanh(x);  // pow(t, 2) is a real pow call
+    return 1 - t * t;
 }
 
 net::Neuron::Neuron(int numWeights) {
@@ -62,6 +64,7 @@ net::Network::Network(std::vector<int> &topology, double lr) {
 }
 
 std::vector<double> net::Network::feedForward(std::vector<double> input) {
+    INSTRUMENT_PHASE("network.feedForward");
     recentInputs = input;
     std::vector<std::vector<double>> firstLayerInputs = {};
     for (int i = 0; i < input.size(); ++i) {
@@ -126,6 +129,7 @@ std::vector<double> net::Network::feedForward(std::vector<double> input) {
 
 // http://techeffigytutorials.blogspot.com/2015/01/neural-network-illustrated-step-by-step.html
 void net::Network::backProp(std::vector<double> &desiredOutput) {
+    INSTRUMENT_PHASE("network.backProp");
     assert(desiredOutput.size() == layers[layers.size() - 1].size());
 
     // std::cout << "backpropping" << std::endl;
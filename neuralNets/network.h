@@ -1,5 +1,7 @@
 // inspired in part by: https://mattmazur.com/2015/03/17/a-step-by-step-backpropagation-example/
 
+#pragma once
+
 #include <vector>
 
 namespace net {
@@ -27,5 +29,8 @@ class Network {
     double learningRate;
     std::vector<double> feedForward(std::vector<double> input);
     void backProp(std::vector<double> &desiredOutput);
+    // read only access so other engines can copy the weights
+    const std::vector<Layer> &getLayers() const { return layers; }
+    const std::vector<double> &getBiases() const { return biases; }
 };
 }  // namespace net
\ No newline at end of file
@@ -0,0 +1,347 @@
+#include "predictor.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// n values of type V rounded up to a whole number of 64 byte lines
+template <typename V>
+int padded(int n) {
+    const int perLine = 64 / sizeof(V);
+    return (n + perLine - 1) / perLine * perLine;
+}
+
+const char magic[8] = {'C', 'S', '3', '2', '0', 'N', 'E', 'T'};
+// 2 added float and int8 models, with a scale per layer. 3 added an activation per layer
+const std::uint32_t version = 3;
+const std::uint32_t byteOrderMark = 0x01020304;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;  // reads back as something else on a machine with the other endianness
+    std::uint32_t valueBytes;
+    std::uint32_t numLayers;
+    std::uint64_t bodyBytes;
+};
+
+// the header, topology and activations, rounded up so the layers start 64 byte aligned
+std::size_t bodyOffset(std::size_t numLayers) {
+    return (sizeof(FileHeader) + 2 * numLayers * sizeof(std::uint32_t) + 63) / 64 * 64;
+}
+}  // namespace
+
+template <typename T>
+net::BasicPredictor<T>::BasicPredictor(const std::vector<int> &topology, const std::vector<Activation> &activations)
+    : sizes(topology), functions(activations) {
+    checkActivations();
+    layout();
+    storage.assign(numBytes, 0);
+    bind(storage.data());
+}
+
+template <typename T>
+void net::BasicPredictor<T>::checkActivations() const {
+    if constexpr (std::is_integral<T>::value) {
+        // the last layer's outputs never get stored as T, so it can be anything
+        for (int i = 0; i + 1 < functions.size(); ++i) {
+            if (functions[i] != Activation::Tanh && functions[i] != Activation::Sigmoid) {
+                throw std::invalid_argument("int8 models need hidden activations in [-1, 1], layer " +
+                                            std::to_string(i) + " is " + toString(functions[i]));
+            }
+        }
+    }
+}
+
+template <typename T>
+void net::BasicPredictor<T>::layout() {
+    strides.clear();
+    widest = 0;
+    numBytes = 0;
+    for (int i = 0; i < sizes.size(); ++i) {
+        strides.push_back(padded<T>(i == 0 ? sizes[0] : sizes[i - 1]));
+        widest = std::max({widest, padded<T>(sizes[i]), padded<Accumulator>(sizes[i]), padded<Real>(sizes[i])});
+        numBytes += (std::size_t)(i == 0 ? 1 : sizes[i]) * strides[i] * sizeof(T) +
+                    padded<Real>(sizes[i]) * sizeof(Real) + 64;
+    }
+}
+
+template <typename T>
+void net::BasicPredictor<T>::bind(const char *body) {
+    // every layer's weights, then its biases, then its scale, back to back
+    weights.clear();
+    biases.clear();
+    scales.clear();
+    for (int i = 0; i < sizes.size(); ++i) {
+        weights.push_back(reinterpret_cast<const T *>(body));
+        body += (std::size_t)(i == 0 ? 1 : sizes[i]) * strides[i] * sizeof(T);
+        biases.push_back(reinterpret_cast<const Real *>(body));
+        body += padded<Real>(sizes[i]) * sizeof(Real);
+        scales.push_back(reinterpret_cast<const Real *>(body));
+        body += 64;
+    }
+}
+
+template <typename T>
+void net::BasicPredictor<T>::setLayer(int i, const double *w, int ld, const double *b) {
+    // the pointers are const for everyone else, but they point into storage, which is ours to fill in
+    T *dst = const_cast<T *>(weights[i]);
+    Real *bias = const_cast<Real *>(biases[i]), *scale = const_cast<Real *>(scales[i]);
+    int rows = i == 0 ? 1 : sizes[i], cols = i == 0 ? sizes[0] : sizes[i - 1];
+    double biggest = 0;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            biggest = std::max(biggest, std::abs(w[(std::size_t)r * ld + c]));
+        }
+    }
+    *scale = std::is_integral<T>::value && biggest > 0 ? biggest / 127 : 1;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            double val = w[(std::size_t)r * ld + c];
+            if constexpr (std::is_integral<T>::value) {
+                dst[(std::size_t)r * strides[i] + c] = (T)std::lround(val / *scale);
+            } else {
+                dst[(std::size_t)r * strides[i] + c] = (T)val;
+            }
+        }
+    }
+    for (int j = 0; j < sizes[i]; ++j) {
+        bias[j] = b[j];
+    }
+}
+
+template <typename T>
+net::BasicPredictor<T>::BasicPredictor(const Network &network) : BasicPredictor([&]() {
+    std::vector<int> topology;
+    for (const Layer &l : network.getLayers()) {
+        topology.push_back(l.size());
+    }
+    return topology;
+}(), std::vector<Activation>(network.getLayers().size(), Activation::Tanh)) {
+    const std::vector<Layer> &layers = network.getLayers();
+    for (int i = 0; i < sizes.size(); ++i) {
+        // Neurons keep their weights separately, so gather them into rows first
+        int cols = i == 0 ? 1 : sizes[i - 1];
+        std::vector<double> w(sizes[i] * cols), b(sizes[i], network.getBiases()[i]);
+        for (int j = 0; j < sizes[i]; ++j) {
+            std::copy(layers[i][j].inputWeights.begin(), layers[i][j].inputWeights.end(), w.begin() + j * cols);
+        }
+        // layer 0's single weights gathered down a column are already the one row it's stored as
+        setLayer(i, w.data(), cols, b.data());
+    }
+}
+
+template <typename T>
+net::BasicPredictor<T>::BasicPredictor(const BatchNetwork &network)
+    : BasicPredictor(network.getTopology(), network.getActivations()) {
+    for (int i = 0; i < sizes.size(); ++i) {
+        const Matrix &w = network.getWeights()[i];
+        setLayer(i, w.data(), w.stride(), network.getBiases()[i].data());
+    }
+}
+
+template <typename T>
+net::BasicPredictor<T> net::BasicPredictor<T>::convert(const BasicPredictor<double> &model) {
+    BasicPredictor converted(model.sizes, model.functions);
+    for (int i = 0; i < converted.sizes.size(); ++i) {
+        converted.setLayer(i, model.weights[i], model.strides[i], model.biases[i]);
+    }
+    return converted;
+}
+
+template <typename T>
+void net::BasicPredictor<T>::save(const std::string &path) const {
+    FileHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.valueBytes = sizeof(T);
+    header.numLayers = sizes.size();
+    header.bodyBytes = numBytes;
+    std::vector<char> head(bodyOffset(sizes.size()), 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    for (int i = 0; i < sizes.size(); ++i) {
+        std::uint32_t size = sizes[i], function = (std::uint32_t)functions[i];
+        std::memcpy(head.data() + sizeof(header) + i * sizeof(size), &size, sizeof(size));
+        std::memcpy(head.data() + sizeof(header) + (sizes.size() + i) * sizeof(size), &function, sizeof(function));
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(head.data(), head.size());
+    // the layers are one block wherever they live, starting at the first layer's weights
+    out.write(reinterpret_cast<const char *>(weights[0]), numBytes);
+    if (!out) {
+        throw std::runtime_error("can't write model to " + path);
+    }
+}
+
+template <typename T>
+net::BasicPredictor<T> net::BasicPredictor<T>::load(const std::string &path) {
+    BasicPredictor model;
+    model.file = MappedFile(path, MappedFile::Access::Normal);
+    const char *data = model.file.data();
+    std::size_t size = model.file.size();
+    auto fail = [&](const std::string &why) { return std::runtime_error("bad model file " + path + ": " + why); };
+    FileHeader header;
+    if (size < sizeof(header)) {
+        throw fail("too short");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw fail("not a model file");
+    }
+    if (header.version != version) {
+        throw fail("version " + std::to_string(header.version) + ", expected " + std::to_string(version));
+    }
+    if (header.byteOrder != byteOrderMark) {
+        throw fail("written on a machine with a different byte order");
+    }
+    if (header.valueBytes != sizeof(T)) {
+        throw fail(std::to_string(header.valueBytes) + " byte weights, expected " + std::to_string(sizeof(T)));
+    }
+    if (header.numLayers == 0 || size < bodyOffset(header.numLayers)) {
+        throw fail("truncated topology");
+    }
+    for (std::uint32_t i = 0; i < header.numLayers; ++i) {
+        std::uint32_t layerSize;
+        std::memcpy(&layerSize, data + sizeof(header) + i * sizeof(layerSize), sizeof(layerSize));
+        if (layerSize == 0) {
+            throw fail("layer " + std::to_string(i) + " is empty");
+        }
+        // nothing gets sized from these until they're known to fit an int (with room for padding) and the file:
+        // every neuron and every weight takes at least a byte of it, so anything bigger is a corrupt file
+        std::uint64_t layerWeights = i == 0 ? layerSize : (std::uint64_t)layerSize * model.sizes[i - 1];
+        if (layerSize > (std::uint32_t)std::numeric_limits<int>::max() - 64 || layerSize > size ||
+            layerWeights > size) {
+            throw fail("layer " + std::to_string(i) + " has " + std::to_string(layerSize) +
+                       " neurons, too many for the file");
+        }
+        model.sizes.push_back(layerSize);
+        std::uint32_t function;
+        std::memcpy(&function, data + sizeof(header) + (header.numLayers + i) * sizeof(function), sizeof(function));
+        if (function > (std::uint32_t)Activation::Linear) {
+            throw fail("layer " + std::to_string(i) + " has unknown activation " + std::to_string(function));
+        }
+        model.functions.push_back((Activation)function);
+    }
+    try {
+        model.checkActivations();
+    } catch (const std::invalid_argument &e) {
+        throw fail(e.what());
+    }
+    model.layout();
+    if (header.bodyBytes != model.numBytes || size != bodyOffset(header.numLayers) + model.numBytes) {
+        throw fail("size doesn't match the topology");
+    }
+    model.bind(data + bodyOffset(header.numLayers));
+    return model;
+}
+
+template <typename T>
+void net::BasicPredictor<T>::reserve(Scratch &scratch, int maxBatch) const {
+    std::size_t size = (std::size_t)maxBatch * widest;
+    if (scratch.a.size() < size) {
+        scratch.a.resize(size);
+        scratch.b.resize(size);
+        if constexpr (std::is_integral<T>::value) {
+            scratch.sums.resize(size);
+            scratch.reals.resize(size);
+        }
+    }
+}
+
+template <typename T>
+void net::BasicPredictor<T>::predictBatch(const double *inputs, int batch, int inputStride, double *outputs,
+                                          int outputStride, Scratch &scratch) const {
+    reserve(scratch, batch);
+    int last = sizes.size() - 1;
+    T *cur = scratch.a.data(), *next = scratch.b.data();
+    for (int i = 0; i <= last; ++i) {
+        /*
+         * each layer's values before activation go in rows of pre. that's next when T is a real type, except for
+         * the last layer of a double model, which goes straight into outputs. int8 needs a separate real buffer,
+         * which gets rounded into next afterwards
+         */
+        bool direct = std::is_same<T, double>::value && i == last;
+        Real *pre;
+        int ld = widest;
+        if constexpr (std::is_integral<T>::value) {
+            pre = scratch.reals.data();
+        } else {
+            pre = direct ? reinterpret_cast<Real *>(outputs) : next;
+            ld = direct ? outputStride : widest;
+        }
+        if (i == 0) {
+            // first layer: each neuron only sees its own input
+            const T *w = weights[0];
+            Real scale = *scales[0];
+            for (int b = 0; b < batch; ++b) {
+                const double *x = inputs + (std::size_t)b * inputStride;
+                Real *y = pre + (std::size_t)b * ld;
+                for (int j = 0; j < sizes[0]; ++j) {
+                    y[j] = std::is_integral<T>::value ? (Real)x[j] * (w[j] * scale) : (Real)x[j] * w[j];
+                }
+            }
+        } else if constexpr (std::is_integral<T>::value) {
+            // integer dot products, then back to real values: weight scale * activation scale (1 / 127)
+            Accumulator *sums = scratch.sums.data();
+            gemmNT(batch, sizes[i], sizes[i - 1], cur, widest, weights[i], strides[i], sums, widest, false);
+            Real scale = *scales[i] / 127;
+            for (int b = 0; b < batch; ++b) {
+                const Accumulator *s = sums + (std::size_t)b * widest;
+                Real *y = pre + (std::size_t)b * ld;
+                for (int j = 0; j < sizes[i]; ++j) {
+                    y[j] = s[j] * scale;
+                }
+            }
+        } else {
+            gemmNT(batch, sizes[i], sizes[i - 1], cur, widest, weights[i], strides[i], pre, ld, false);
+        }
+        for (int b = 0; b < batch; ++b) {
+            Real *y = pre + (std::size_t)b * ld;
+            activate(functions[i], y, biases[i], sizes[i]);
+            if (i == last && !direct) {
+                std::copy(y, y + sizes[i], outputs + (std::size_t)b * outputStride);
+            } else if (std::is_integral<T>::value && i != last) {
+                T *q = next + (std::size_t)b * widest;
+                for (int j = 0; j < sizes[i]; ++j) {
+                    q[j] = (T)std::lround(y[j] * 127);
+                }
+            }
+        }
+        std::swap(cur, next);
+    }
+}
+
+template <typename T>
+void net::BasicPredictor<T>::predictBatch(const Matrix &inputs, Matrix &outputs, Scratch &scratch) const {
+    assert(inputs.cols() == inputSize());
+    outputs.resize(inputs.rows(), outputSize());
+    predictBatch(inputs.data(), inputs.rows(), inputs.stride(), outputs.data(), outputs.stride(), scratch);
+}
+
+template <typename T>
+void net::BasicPredictor<T>::predict(const double *input, double *output, Scratch &scratch) const {
+    predictBatch(input, 1, inputSize(), output, outputSize(), scratch);
+}
+
+template <typename T>
+void net::BasicPredictor<T>::predict(const double *input, double *output) const {
+    thread_local Scratch scratch;
+    predict(input, output, scratch);
+}
+
+template <typename T>
+std::vector<double> net::BasicPredictor<T>::predict(const std::vector<double> &input) const {
+    assert(input.size() == inputSize());
+    std::vector<double> output(outputSize());
+    predict(input.data(), output.data());
+    return output;
+}
+
+template class net::BasicPredictor<double>;
+template class net::BasicPredictor<float>;
+template class net::BasicPredictor<std::int8_t>;
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "activation.h"
+#include "batchnetwork.h"
+#include "mappedfile.h"
+#include "matrix.h"
+#include "network.h"
+
+namespace net {
+/*
+ * read only copy of a trained network for inference. the weights are laid out like BatchNetwork's (each layer one
+ * aligned row major block) and never change after construction, and everything a pass needs to write goes in a
+ * Scratch the caller owns, so any number of threads can predict with one Predictor at the same time.
+ * once a Scratch has seen the biggest batch it's going to get, predicting never allocates.
+ *
+ * T is what the weights and the activations between layers are stored as:
+ *   double: same results as BatchNetwork (and Network, to rounding)
+ *   float: half the memory traffic and twice the simd width
+ *   int8_t: post training quantization. each layer's weights are scaled by their own scale (biggest |weight| / 127)
+ *     and activations by 1 / 127, so every hidden layer has to be tanh or sigmoid (anything else throws
+ *     std::invalid_argument). dot products are exact 32 bit integer sums, scaled back to float for the activation
+ * inputs and outputs are always doubles, so every precision is a drop in replacement for the others.
+ *
+ * save writes the weights to a binary model file in exactly the layout they're used in, and load maps the file and
+ * predicts straight from the mapped pages: no parsing, no copying, and every process using the same file shares
+ * one copy. the file (all native endian):
+ *   magic "CS320NET", u32 version, u32 byte order mark 0x01020304, u32 bytes per weight (8, 4 or 1),
+ *   u32 number of layers, u64 bytes of layer data, then a u32 per layer (its size), then a u32 per layer (its
+ *   Activation), zero padded to 64 bytes
+ *   then per layer, each part zero padded to a multiple of 64 bytes: the weights, one padded row per neuron
+ *   (layer 0 is a single row, one weight per input), the biases, and the layer's weight scale (1 unless int8).
+ *   biases and scales are floats for int8 models, otherwise T. everything stays 64 byte aligned since the mapping
+ *   starts on a page
+ */
+template <typename T>
+class BasicPredictor {
+   public:
+    // biases, scales and the math around them
+    typedef typename std::conditional<std::is_integral<T>::value, float, T>::type Real;
+    // what dot products of T add up in
+    typedef typename std::conditional<std::is_integral<T>::value, std::int32_t, T>::type Accumulator;
+
+    // ping pong buffers for the layer outputs. one per thread, or use the overloads that keep one per thread
+    struct Scratch {
+        AlignedVector<T> a, b;
+        // only used by int8: the dot products, then the real values they stand for
+        AlignedVector<Accumulator> sums;
+        AlignedVector<Real> reals;
+    };
+
+    explicit BasicPredictor(const Network &network);
+    explicit BasicPredictor(const BatchNetwork &network);
+    // the same model at this precision (quantized, for int8)
+    static BasicPredictor convert(const BasicPredictor<double> &model);
+    // the layer pointers point into storage, which a copy wouldn't bring along
+    BasicPredictor(const BasicPredictor &) = delete;
+    BasicPredictor &operator=(const BasicPredictor &) = delete;
+    BasicPredictor(BasicPredictor &&) = default;
+    BasicPredictor &operator=(BasicPredictor &&) = default;
+
+    // throws std::runtime_error if the file can't be written/read, is corrupt or isn't a model of this precision
+    void save(const std::string &path) const;
+    static BasicPredictor load(const std::string &path);
+
+    // grows scratch so batches up to maxBatch samples don't allocate
+    void reserve(Scratch &scratch, int maxBatch) const;
+
+    // batch samples, rows inputStride doubles apart. outputs get one row of outputSize() per sample
+    void predictBatch(const double *inputs, int batch, int inputStride, double *outputs, int outputStride,
+                      Scratch &scratch) const;
+    // one sample per row. outputs is resized to batch x outputSize(), which is free when it's already that shape
+    void predictBatch(const Matrix &inputs, Matrix &outputs, Scratch &scratch) const;
+    void predict(const double *input, double *output, Scratch &scratch) const;
+    // same as above with a scratch kept per thread
+    void predict(const double *input, double *output) const;
+    // same signature as Network::feedForward. allocates the returned vector
+    std::vector<double> predict(const std::vector<double> &input) const;
+
+    int inputSize() const { return sizes.front(); }
+    int outputSize() const { return sizes.back(); }
+    const std::vector<int> &getTopology() const { return sizes; }
+    const std::vector<Activation> &getActivations() const { return functions; }
+    std::size_t bytes() const { return numBytes; }  // size of the weights, biases and scales
+
+   private:
+    template <typename U>
+    friend class BasicPredictor;
+
+    BasicPredictor() = default;
+    // zeroed layers in storage
+    BasicPredictor(const std::vector<int> &topology, const std::vector<Activation> &activations);
+    // throws if a hidden layer's activation can't be stored as T
+    void checkActivations() const;
+    // works out strides, widest and numBytes for sizes
+    void layout();
+    // points weights, biases and scales at the layers in a block of numBytes bytes laid out like the file body
+    void bind(const char *body);
+    // rounds (and for int8 scales) a layer's weights into storage. w is that layer's rows, ld values apart
+    void setLayer(int i, const double *w, int ld, const double *b);
+
+    std::vector<int> sizes;
+    std::vector<Activation> functions;
+    std::vector<int> strides;  // row stride of each layer's weights, padded to 64 bytes
+    std::vector<const T *> weights;
+    std::vector<const Real *> biases, scales;
+    int widest = 0;  // padded width of the widest layer, the row stride of the scratch buffers
+    std::size_t numBytes = 0;
+    // the layers live in one of these, storage when built from a network, file when loaded
+    AlignedVector<char> storage;
+    MappedFile file;
+};
+
+typedef BasicPredictor<double> Predictor;
+typedef BasicPredictor<float> FloatPredictor;
+typedef BasicPredictor<std::int8_t> Int8Predictor;
+
+// defined in predictor.cpp for these three
+extern template class BasicPredictor<double>;
+extern template class BasicPredictor<float>;
+extern template class BasicPredictor<std::int8_t>;
+}  // namespace net
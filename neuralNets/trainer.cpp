@@ -0,0 +1,160 @@
+#include "trainer.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include "instrument.h"
+
+namespace {
+// everyone waits until all count threads have called wait, then they all go on
+class Barrier {
+   public:
+    explicit Barrier(int count_) : count(count_) {}
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        long arrivedIn = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            ++generation;
+            lock.unlock();
+            released.notify_all();
+        } else {
+            released.wait(lock, [&]() { return generation != arrivedIn; });
+        }
+    }
+
+   private:
+    std::mutex mutex;
+    std::condition_variable released;
+    int count, waiting = 0;
+    long generation = 0;
+};
+
+// copies the samples order[begin, end) into rows of in and out
+void gather(const net::Matrix &inputs, const net::Matrix &targets, const std::vector<int> &order, int begin, int end,
+            net::Matrix &in, net::Matrix &out) {
+    in.resize(end - begin, inputs.cols());
+    out.resize(end - begin, targets.cols());
+    for (int s = begin; s < end; ++s) {
+        std::copy(inputs.row(order[s]), inputs.row(order[s]) + inputs.cols(), in.row(s - begin));
+        std::copy(targets.row(order[s]), targets.row(order[s]) + targets.cols(), out.row(s - begin));
+    }
+}
+
+template <typename Fn>
+void runThreads(int numThreads, Fn fn) {
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) {
+        threads.emplace_back(fn, t);
+    }
+    fn(0);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+}
+}  // namespace
+
+net::Trainer::Trainer(BatchNetwork &network_, int numThreads_, Mode mode_) : network(network_) {
+    numThreads = numThreads_ > 0 ? numThreads_ : std::max(1u, std::thread::hardware_concurrency());
+    mode = mode_;
+}
+
+double net::Trainer::trainEpoch(const Matrix &inputs, const Matrix &targets) {
+    INSTRUMENT_PHASE("trainer.epoch");
+    std::vector<int> order(inputs.rows());
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(seed + epoch);
+    std::shuffle(order.begin(), order.end(), gen);
+    ++epoch;
+
+    std::vector<double> errors(numThreads, 0.0);
+    if (mode == Mode::Synchronous) {
+        synchronous(inputs, targets, order, errors);
+    } else {
+        hogwild(inputs, targets, order, errors);
+    }
+    double total = 0;
+    for (double e : errors) {
+        total += e;
+    }
+    double loss = total / std::max(1, inputs.rows() * targets.cols());
+    INSTRUMENT_COUNT("trainer.samples", inputs.rows());
+    INSTRUMENT_EVENT("trainer.loss", loss);
+    return loss;
+}
+
+void net::Trainer::synchronous(const Matrix &inputs, const Matrix &targets, const std::vector<int> &order,
+                               std::vector<double> &errors) {
+    int n = order.size(), steps = (n + batchSize - 1) / batchSize;
+    std::vector<Gradients> grads(numThreads);
+    Barrier barrier(numThreads);
+    runThreads(numThreads, [&](int t) {
+        Workspace ws;
+        Matrix in, out;
+        for (int step = 0; step < steps; ++step) {
+            // this thread's slice of the step's batch
+            int lo = step * batchSize, hi = std::min(n, lo + batchSize);
+            gather(inputs, targets, order, lo + (hi - lo) * t / numThreads, lo + (hi - lo) * (t + 1) / numThreads, in,
+                   out);
+            network.forward(in, ws);
+            errors[t] += network.gradients(out, ws, grads[t]);
+            barrier.wait();
+            // tree reduction: in round r, thread t (a multiple of 2^(r + 1)) adds in thread t + 2^r's gradient
+            for (int stride = 1; stride < numThreads; stride *= 2) {
+                if (t % (2 * stride) == 0 && t + stride < numThreads) {
+                    grads[t].add(grads[t + stride]);
+                }
+                barrier.wait();
+            }
+            if (t == 0) {
+                network.apply(grads[0], network.learningRate);
+            }
+            barrier.wait();
+        }
+    });
+}
+
+void net::Trainer::hogwild(const Matrix &inputs, const Matrix &targets, const std::vector<int> &order,
+                           std::vector<double> &errors) {
+    int n = order.size();
+    std::size_t count = network.parameterCount();
+    std::vector<double> start(count);
+    network.getParameters(start.data());
+    // the shared weights. relaxed atomic loads and stores cost the same as plain ones on x86, but unlike plain
+    // doubles written from several threads they aren't a data race
+    std::vector<std::atomic<double>> shared(count);
+    for (std::size_t p = 0; p < count; ++p) {
+        shared[p].store(start[p], std::memory_order_relaxed);
+    }
+    runThreads(numThreads, [&](int t) {
+        BatchNetwork local = network;  // every thread steps its own copy, then merges the step into shared
+        Workspace ws;
+        Gradients grads;
+        Matrix in, out;
+        std::vector<double> before(start), after(count);
+        int end = (long)n * (t + 1) / numThreads;
+        for (int lo = (long)n * t / numThreads; lo < end; lo += batchSize) {
+            gather(inputs, targets, order, lo, std::min(end, lo + batchSize), in, out);
+            local.forward(in, ws);
+            errors[t] += local.gradients(out, ws, grads);
+            local.apply(grads, local.learningRate);
+            local.getParameters(after.data());
+            for (std::size_t p = 0; p < count; ++p) {
+                double current = shared[p].load(std::memory_order_relaxed);
+                // nobody else changed it since this thread last looked: take the step's result as is, so a single
+                // thread trains exactly like Synchronous. a concurrent update in between a load and store is lost
+                double updated = current == before[p] ? after[p] : current + (after[p] - before[p]);
+                shared[p].store(updated, std::memory_order_relaxed);
+                before[p] = updated;
+            }
+            local.setParameters(before.data());
+        }
+    });
+    for (std::size_t p = 0; p < count; ++p) {
+        start[p] = shared[p].load(std::memory_order_relaxed);
+    }
+    network.setParameters(start.data());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "batchnetwork.h"
+
+namespace net {
+/*
+ * trains a BatchNetwork on several threads at once, each epoch's (shuffled) samples split between them.
+ * Synchronous: every step, each thread computes the gradient of its share of a batchSize batch, the gradients get
+ * added up pairwise in a tree (log2(threads) rounds), and the sum is applied once. same seed and thread count =
+ * exactly the same training run.
+ * Hogwild: each thread trains on its own part of the epoch and applies its updates straight to the shared
+ * weights with no locking at all (Niu et al., "Hogwild!", 2011). the shared weights are relaxed atomics, read
+ * into a copy of the network for each batch, so there's no data race, but updates occasionally step on each other,
+ * which sgd shrugs off, and nobody ever waits. not reproducible past one thread (one thread trains exactly like
+ * Synchronous)
+ */
+class Trainer {
+   public:
+    enum class Mode {
+        Synchronous,
+        Hogwild
+    };
+
+    Trainer(BatchNetwork &network_, int numThreads_ = 0, Mode mode_ = Mode::Synchronous);  // 0 threads = one per core
+
+    int batchSize = 64;  // samples per update. in Hogwild mode it's per thread
+    unsigned seed = 320;  // shuffles the samples, epoch e uses seed + e
+
+    // one pass over the data, one sample per row. returns the mean squared error of the outputs seen along the way
+    double trainEpoch(const Matrix &inputs, const Matrix &targets);
+
+    int threads() const { return numThreads; }
+
+   private:
+    void synchronous(const Matrix &inputs, const Matrix &targets, const std::vector<int> &order,
+                     std::vector<double> &errors);
+    void hogwild(const Matrix &inputs, const Matrix &targets, const std::vector<int> &order,
+                 std::vector<double> &errors);
+
+    BatchNetwork &network;
+    int numThreads;
+    Mode mode;
+    int epoch = 0;
+};
+}  // namespace net